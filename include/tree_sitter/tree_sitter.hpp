@@ -1,14 +1,21 @@
 #ifndef TREE_SITTER_HPP
 #define TREE_SITTER_HPP
 
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
 #include <cstdint>
 #include <exception>
 #include <functional>
+#include <iterator>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <stdexcept>
+#include <string>
 #include <string_view>
 #include <tree_sitter/api.h>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -42,13 +49,14 @@ public:
 };
 
 /**
- * @brief Thrown by Parser::parse_string (should never actually be thrown).
+ * @brief Thrown by Parser::parse_string (and the other parse methods) if
+ * parsing did not finish.
  *
- * Because we:
+ * We always set a language. So this is only thrown if a timeout was set with
+ * Parser::set_timeout_micros and was reached or if the flag set with
+ * Parser::set_cancellation_flag was set.
  *
- * - always set a language
- * - never set a timeout
- * - never set the cancellation flag
+ * Use ParseTask if you want to resume parsing in these cases.
  */
 class ParseFailureException : public TreeSitterException {
 public:
@@ -98,22 +106,75 @@ public:
 };
 
 /**
- * @brief Base class for exceptions related to applying edits to the tree.
+ * @brief A source file could not be read.
  *
- * Subclasses of this are thrown by Tree::edit.
+ * Thrown by Source::map_file and Parser::parse_file if the file can't be
+ * opened or mapped into memory.
  */
-class EditException : public TreeSitterException {};
+class FileException : public TreeSitterException, public std::runtime_error {
+    const int error_;
+
+public:
+    FileException(const std::string& path, int error);
+
+    /**
+     * @brief The `errno` value describing the error.
+     */
+    [[nodiscard]] int error() const;
+};
+
+/**
+ * @brief Included ranges have to be sorted and must not overlap.
+ *
+ * Thrown by Parser::set_included_ranges and LayeredTree.
+ */
+class IncludedRangesException : public TreeSitterException, public std::runtime_error {
+public:
+    IncludedRangesException();
+};
+
+/**
+ * @brief The source code of the tree has a different encoding than requested.
+ *
+ * Thrown e.g. by Node::text for trees parsed from UTF-16 source code and by
+ * Node::text_utf16 for trees parsed from UTF-8 source code.
+ */
+class EncodingException : public TreeSitterException, public std::runtime_error {
+public:
+    EncodingException();
+};
+
+/**
+ * @brief The requested text is not stored in one contiguous string.
+ *
+ * Thrown by Node::text_view if the tree reads its source code with a Reader
+ * (see Parser::parse) or if the text spans multiple pieces of a PieceTable.
+ * Use Node::text or Node::for_each_chunk instead.
+ */
+class TextViewException : public TreeSitterException, public std::runtime_error {
+public:
+    TextViewException();
+};
 
 /**
- * @brief Newlines are not allowed in [Edit](@ref Edit)s.
+ * @brief A field name or FieldHandle does not fit the language.
  *
- * Thrown by Tree::edit if any of the edits contain newlines.
+ * Thrown by the constructor of FieldHandle if the language has no field with
+ * the name and by the Node methods taking a FieldHandle if the node's tree was
+ * parsed with a different language than the handle was resolved for.
  */
-class MultilineEditException : public EditException, public std::runtime_error {
+class FieldException : public TreeSitterException, public std::runtime_error {
 public:
-    MultilineEditException();
+    explicit FieldException(const std::string& message);
 };
 
+/**
+ * @brief Base class for exceptions related to applying edits to the tree.
+ *
+ * Subclasses of this are thrown by Tree::edit.
+ */
+class EditException : public TreeSitterException {};
+
 /**
  * @brief Overlapping [Edit](@ref Edit)s are not allowed.
  *
@@ -125,13 +186,14 @@ public:
 };
 
 /**
- * @brief Empty [Edit](@ref Edit)s are not allwed.
+ * @brief A Tree without source code string can't apply [Edit](@ref Edit)s.
  *
- * Thrown by Tree::edit if any of the edits have size zero.
+ * Thrown by Tree::edit if the tree was created with Parser::parse. Use the
+ * overload of Tree::edit that takes a Reader for these trees.
  */
-class ZeroSizedEditException : public EditException, public std::runtime_error {
+class MissingSourceException : public EditException, public std::runtime_error {
 public:
-    ZeroSizedEditException();
+    MissingSourceException();
 };
 
 /**
@@ -290,8 +352,48 @@ struct Edit {
     Range range;
     /**
      * @brief The replacement.
+     *
+     * For UTF-16 source code these are the raw bytes of the UTF-16
+     * replacement (see Edit::utf16).
      */
     std::string replacement;
+    /**
+     * @brief Only the byte offsets of the range are set and the points are
+     * computed by Tree::edit (see Edit::from_bytes).
+     */
+    bool bytes_only = false;
+
+    /**
+     * @brief Create an edit that only specifies the byte offsets.
+     *
+     * Tree::edit computes the points using the line index of the tree (see
+     * Tree::line_index). This takes O(log lines) per edit instead of scanning
+     * the source code.
+     *
+     * \note For trees created with Parser::parse the line index is created
+     * from the Reader of the tree if it does not exist yet. So either call
+     * Tree::line_index before changing the source code read by the Reader or
+     * don't use this for these trees.
+     */
+    static Edit
+    from_bytes(std::uint32_t start_byte, std::uint32_t end_byte, std::string replacement);
+
+    /**
+     * @brief Create an edit for UTF-16 source code.
+     *
+     * The range is counted in bytes of the UTF-16 source code (see
+     * Encoding::UTF16) and the replacement is stored as its raw bytes.
+     */
+    static Edit utf16(Range range, std::u16string_view replacement);
+
+    /**
+     * @brief Create an edit for UTF-16 source code that only specifies the
+     * byte offsets.
+     *
+     * See Edit::from_bytes and Edit::utf16.
+     */
+    static Edit
+    from_bytes(std::uint32_t start_byte, std::uint32_t end_byte, std::u16string_view replacement);
 };
 
 bool operator==(const Edit&, const Edit&);
@@ -299,6 +401,172 @@ bool operator!=(const Edit&, const Edit&);
 std::ostream& operator<<(std::ostream&, const Edit&);
 std::ostream& operator<<(std::ostream&, const std::vector<Edit>&);
 
+/**
+ * @brief The encoding of a Source.
+ */
+enum class Encoding {
+    UTF8,
+    /**
+     * @brief UTF-16 in native byte order.
+     *
+     * All byte offsets and columns (see Location) are counted in bytes of the
+     * UTF-16 buffer, i.e. twice the number of UTF-16 code units.
+     */
+    UTF16,
+};
+
+/**
+ * @brief Immutable source code buffer that a Tree refers to.
+ *
+ * This is a cheap handle to the source code: a view of the text and an
+ * optional reference counted owner that keeps the text alive. Copying a
+ * Source never copies the text itself.
+ *
+ * There are three ways to create a Source:
+ *
+ * - from a `std::string`: the Source takes ownership of the string (by copy
+ *   or move)
+ * - from a `std::shared_ptr<const std::string>` (or any other owner): the
+ *   Source shares an externally owned buffer
+ * - with Source::borrow: the Source only references the text and the caller
+ *   has to guarantee that it outlives every Tree (and Node) using it
+ *
+ * UTF-16 source code can be used with Source::utf16 and Source::borrow_utf16.
+ */
+class Source {
+    std::string_view view_;
+    // keeps the memory behind view_ alive (nullptr for borrowed sources)
+    std::shared_ptr<const void> owner_;
+    Encoding encoding_ = Encoding::UTF8;
+
+public:
+    /**
+     * @brief Create an empty source.
+     */
+    Source() noexcept = default;
+
+    /**
+     * @brief Take ownership of the given string.
+     *
+     * This is intentionally not explicit so a `std::string` can be used
+     * wherever a Source is expected.
+     */
+    Source(std::string);
+
+    /**
+     * @brief Share an externally owned, immutable string.
+     *
+     * The string is kept alive for as long as the Source (or any Tree
+     * created from it) exists.
+     */
+    Source(std::shared_ptr<const std::string>);
+
+    /**
+     * @brief Take ownership of the raw bytes of source code in the given
+     * encoding.
+     *
+     * For Encoding::UTF16 these are the bytes of the code units in native
+     * byte order (see Source::view).
+     */
+    Source(std::string bytes, Encoding encoding);
+
+    /**
+     * @brief Refer to `view` and keep `owner` alive.
+     *
+     * `view` has to point into memory that is managed by `owner`.
+     */
+    Source(std::string_view view, std::shared_ptr<const void> owner) noexcept;
+
+    /**
+     * @brief Refer to the given string without owning it.
+     *
+     * \warning The caller has to guarantee that the string outlives the
+     * Source and every Tree created from it.
+     */
+    static Source borrow(std::string_view) noexcept;
+
+    /**
+     * @brief Map the given file read-only into memory.
+     *
+     * The mapping is kept alive for as long as the Source (or any Tree
+     * created from it) exists. The file should not be modified while it is
+     * mapped.
+     *
+     * `path` has to be a null-terminated string (e.g. from a std::string).
+     *
+     * Throws FileException if the file can't be opened or mapped.
+     */
+    static Source map_file(std::string_view path);
+
+    /**
+     * @brief Take ownership of the given UTF-16 string.
+     */
+    static Source utf16(std::u16string);
+
+    /**
+     * @brief Refer to the given UTF-16 string without owning it.
+     *
+     * \warning See Source::borrow.
+     */
+    static Source borrow_utf16(std::u16string_view) noexcept;
+
+    /**
+     * @brief The encoding of the source code.
+     */
+    [[nodiscard]] Encoding encoding() const noexcept;
+
+    /**
+     * @brief The source code.
+     *
+     * For UTF-16 source code this is a view of the raw bytes.
+     */
+    [[nodiscard]] std::string_view view() const noexcept;
+
+    /**
+     * @brief The UTF-16 source code.
+     *
+     * Throws EncodingException if the source code is not UTF-16.
+     */
+    [[nodiscard]] std::u16string_view utf16_view() const;
+
+    /**
+     * @brief Pointer to the first character of the source code.
+     */
+    [[nodiscard]] const char* data() const noexcept;
+
+    /**
+     * @brief Size of the source code in bytes.
+     */
+    [[nodiscard]] std::size_t size() const noexcept;
+
+    /**
+     * @brief Check if the source code is only borrowed (i.e. not kept alive
+     * by the Source).
+     */
+    [[nodiscard]] bool is_borrowed() const noexcept;
+
+    /**
+     * @brief A part of the source code that shares the buffer of this Source.
+     *
+     * `pos` and `count` are in bytes (like for `std::string_view::substr`).
+     */
+    [[nodiscard]] Source substr(std::size_t pos, std::size_t count = std::string_view::npos) const;
+};
+
+/**
+ * @brief Callback that provides the source code in chunks.
+ *
+ * It is called with a byte offset and has to return a chunk of the source
+ * code that starts at that offset. An empty chunk signals the end of the
+ * source code. The chunk can have any size (e.g. a node of a rope or a
+ * buffer of a file reader).
+ *
+ * The returned view only has to stay valid until the next call.
+ *
+ * \warning The callback is called from within Tree-Sitter and must not throw.
+ */
+using Reader = std::function<std::string_view(std::uint32_t byte)>;
+
 /**
  * @brief Tree-Sitter language grammar.
  *
@@ -380,9 +648,47 @@ public:
  */
 bool language_compatible(const Language&);
 
+/**
+ * @brief A field name resolved to its FieldId for one Language.
+ *
+ * Resolve the handle once (e.g. when setting up an analysis) and use it for all
+ * nodes of that language. Looking up children with it (e.g. with
+ * Node::child_by_field) then only compares numbers instead of field names.
+ */
+class FieldHandle {
+    const TSLanguage* language_;
+    FieldId id_;
+
+public:
+    /**
+     * @brief Resolves `name` with Language::field_id.
+     *
+     * Throws FieldException if the language has no field with this name.
+     */
+    FieldHandle(const Language& language, std::string_view name);
+
+    /**
+     * @brief The FieldId of the field.
+     */
+    [[nodiscard]] FieldId id() const noexcept;
+
+    /**
+     * @brief The language the field was resolved for.
+     */
+    [[nodiscard]] Language language() const noexcept;
+
+    /**
+     * @brief The name of the field.
+     */
+    [[nodiscard]] const char* name() const;
+};
+
 // forward declarations
 class Cursor;
+class ChildRange;
 class Tree;
+class ParserPool;
+class PieceTable;
 
 /**
  * @brief A syntax node in a parsed tree.
@@ -407,16 +713,6 @@ class Tree;
  *
  * Features not included (because we currently don't use them):
  *
- * - Get child by field:
- *   - `ts_node_child_by_field_name`
- *   - `ts_node_child_by_field_id`
- * - Get child/decendant for byte/point (range):
- *   - `ts_node_first_child_for_byte`
- *   - `ts_node_first_named_child_for_byte`
- *   - `ts_node_descendant_for_byte_range`
- *   - `ts_node_descendant_for_point_range`
- *   - `ts_node_named_descendant_for_byte_range`
- *   - `ts_node_named_descendant_for_point_range`
  * - Editing nodes directly (but we support this through the Tree):
  *   - `ts_node_edit`
  */
@@ -541,6 +837,15 @@ public:
      */
     [[nodiscard]] std::vector<Node> children() const;
 
+    /**
+     * @brief Iterate over all children (named and anonymous) without
+     * creating a list.
+     *
+     * Unlike calling Node::child for every index this takes linear time (see
+     * ChildRange).
+     */
+    [[nodiscard]] ChildRange child_range() const;
+
     /**
      * @brief The n-th **named** child (0 indexed).
      *
@@ -561,6 +866,47 @@ public:
      */
     [[nodiscard]] std::vector<Node> named_children() const;
 
+    /**
+     * @brief Iterate over the named children without creating a list.
+     *
+     * See Node::child_range.
+     */
+    [[nodiscard]] ChildRange named_child_range() const;
+
+    /**
+     * @brief The first child with the given field (named or anonymous).
+     *
+     * Returns `std::nullopt` if there is no child with this field. FieldId 0
+     * is used for children without a field, so no child is returned for it.
+     *
+     * The FieldHandle overload throws FieldException if the handle was
+     * resolved for a different language.
+     */
+    [[nodiscard]] std::optional<Node> child_by_field(FieldId) const;
+    [[nodiscard]] std::optional<Node> child_by_field(const FieldHandle&) const;
+
+    /**
+     * @brief List of all children with the given field.
+     *
+     * Some fields can occur multiple times (e.g. the elements of a list).
+     * The list is empty for FieldId 0.
+     *
+     * See Node::child_by_field.
+     */
+    [[nodiscard]] std::vector<Node> children_by_field(FieldId) const;
+    [[nodiscard]] std::vector<Node> children_by_field(const FieldHandle&) const;
+
+    /**
+     * @brief Iterate over the children with the given field without creating
+     * a list.
+     *
+     * See Node::child_by_field and Node::child_range. Use
+     * ChildRange::iterator::field_id with Node::child_range to visit all
+     * children together with their fields.
+     */
+    [[nodiscard]] ChildRange field_child_range(FieldId) const;
+    [[nodiscard]] ChildRange field_child_range(const FieldHandle&) const;
+
     /**
      * @brief The node's next sibling.
      *
@@ -597,6 +943,59 @@ public:
      */
     [[nodiscard]] std::optional<Node> prev_named_sibling() const;
 
+    /**
+     * @brief The first child that ends after the given byte offset.
+     *
+     * This is the child containing the byte (or the first child after it).
+     *
+     * Returns `std::nullopt` if no child ends after the byte.
+     */
+    [[nodiscard]] std::optional<Node> first_child_for_byte(std::uint32_t byte) const;
+
+    /**
+     * @brief The first named child that ends after the given byte offset.
+     *
+     * See Node::first_child_for_byte.
+     */
+    [[nodiscard]] std::optional<Node> first_named_child_for_byte(std::uint32_t byte) const;
+
+    /**
+     * @brief The smallest node inside this node that spans the given byte range.
+     *
+     * Use an empty range to find the node at a position (e.g. the cursor of an
+     * editor). The node is found by descending from this node, so this takes
+     * time proportional to the depth of the tree and not to its size.
+     *
+     * Returns this node if no descendant spans the range (also if the range is
+     * outside of this node).
+     */
+    [[nodiscard]] Node descendant_for_byte_range(std::uint32_t start, std::uint32_t end) const;
+
+    /**
+     * @brief The smallest node inside this node that spans the given point
+     * range.
+     *
+     * See Node::descendant_for_byte_range.
+     */
+    [[nodiscard]] Node descendant_for_point_range(Point start, Point end) const;
+
+    /**
+     * @brief The smallest **named** node inside this node that spans the given
+     * byte range.
+     *
+     * See Node::descendant_for_byte_range.
+     */
+    [[nodiscard]] Node named_descendant_for_byte_range(
+        std::uint32_t start, std::uint32_t end) const;
+
+    /**
+     * @brief The smallest **named** node inside this node that spans the given
+     * point range.
+     *
+     * See Node::descendant_for_byte_range.
+     */
+    [[nodiscard]] Node named_descendant_for_point_range(Point start, Point end) const;
+
     /**
      * @brief Start position as byte offset.
      */
@@ -636,269 +1035,1634 @@ public:
 
     /**
      * @brief The substring of source code this node represents.
+     *
+     * Throws EncodingException if the tree was parsed from UTF-16 source code.
      */
     [[nodiscard]] std::string text() const;
 
     /**
-     * @brief A string representation of the syntax tree starting from the node
-     * represented as an s-expression.
+     * @brief The substring of source code this node represents without
+     * copying it.
+     *
+     * The view points into the source code of the tree, so it is only valid as
+     * long as the tree is not edited or destructed.
+     *
+     * Throws TextViewException if the text is not stored in one string (see
+     * Tree::text_view) and EncodingException if the tree was parsed from
+     * UTF-16 source code.
      */
-    [[nodiscard]] std::string as_s_expr() const;
-};
-
-bool operator==(const Node& lhs, const Node& rhs);
-bool operator!=(const Node& lhs, const Node& rhs);
-std::ostream& operator<<(std::ostream&, const Node&);
-std::ostream& operator<<(std::ostream&, const std::optional<Node>&);
-
-/**
- * @brief Parser for a Tree-Sitter language.
- *
- * The default constructor uses @ref LUA_LANGUAGE.
- *
- * Features not included (because we currently don't use them):
- *
- * - Partial document parsing:
- *   - `ts_parser_set_included_ranges`
- *   - `ts_parser_included_ranges`
- * - alternative parse sources (other than utf8 string)
- *   - generalized `ts_parser_parse` (with TSInput)
- *   - `ts_parser_parse_string_encoding`
- * - parsing timeout/cancellation
- *   - `ts_parser_reset`
- *   - `ts_parser_set_timeout_micros`
- *   - `ts_parser_timeout_micros`
- *   - `ts_parser_set_cancellation_flag`
- *   - `ts_parser_cancellation_flag`
- * - Grammar debug features:
- *   - `ts_parser_set_logger`
- *   - `ts_parser_logger`
- *   - `ts_parser_print_dot_graphs`
- */
-class Parser {
-    std::unique_ptr<TSParser, void (*)(TSParser*)> parser;
+    [[nodiscard]] std::string_view text_view() const;
 
-public:
     /**
-     * @brief Create a parser using the given language.
+     * @brief If the text of this node is equal to `text`.
+     *
+     * Same as `node.text() == text` but this never allocates (and also works
+     * for trees created with Parser::parse).
+     *
+     * Throws EncodingException if the tree was parsed from UTF-16 source code.
      */
-    Parser(const Language&);
+    [[nodiscard]] bool text_equals(std::string_view text) const;
 
     /**
-     * @brief Returns the raw Tree-Sitter parser.
+     * @brief If the text of this node starts with `prefix`.
      *
-     * \warning
-     * Use with care. Only intended vor internal use in the wrapper types.
-     *
-     * \warning
-     * Never free or otherwise delete this pointer.
+     * Never allocates (see Node::text_equals).
      */
-    [[nodiscard]] TSParser* raw() const;
+    [[nodiscard]] bool text_starts_with(std::string_view prefix) const;
 
     /**
-     * @brief The Language the parser was created from.
+     * @brief The hash of the text of this node (see ts::text_hash).
+     *
+     * Never allocates (see Node::text_equals).
      */
-    [[nodiscard]] Language language() const;
+    [[nodiscard]] std::uint64_t text_hash() const;
 
     /**
-     * @brief Parse a string and return its syntax tree.
+     * @brief The substring of UTF-16 source code this node represents.
      *
-     * This takes the source code by copy (or move) and stores it in the tree.
+     * This also works for trees created with Parser::parse_piece_table.
+     *
+     * Throws EncodingException if the tree was not parsed from UTF-16 source
+     * code.
      */
-    Tree parse_string(std::string) const;
+    [[nodiscard]] std::u16string text_utf16() const;
 
     /**
-     * @brief Parse a string and return its syntax tree.
+     * @brief The substring of UTF-16 source code this node represents
+     * without copying it.
      *
-     * This takes the source code by copy (or move) and a previously parsed tree.
+     * The view points into the source code of the tree, so it is only valid as
+     * long as the tree is not edited or destructed.
      *
-     * \note Only for internal use.
+     * Throws TextViewException if the text is not stored in one string (see
+     * Tree::text_view) and EncodingException if the tree was not parsed from
+     * UTF-16 source code.
      */
-    Tree parse_string(const TSTree* old_tree, std::string source) const;
-};
+    [[nodiscard]] std::u16string_view text_utf16_view() const;
 
-/**
- * @brief Holds information about an applied Edit.
- *
- * `after` could for example be used to highlight changed locations in an editor.
- *
- * Supports equality operators.
+    /**
+     * @brief Call `fn` with the chunks of source code this node represents
+     * without copying them.
+     *
+     * See Tree::for_each_chunk.
+     */
+    void for_each_chunk(const std::function<void(std::string_view)>& fn) const;
+
+    /**
+     * @brief A string representation of the syntax tree starting from the node
+     * represented as an s-expression.
+     */
+    [[nodiscard]] std::string as_s_expr() const;
+};
+
+bool operator==(const Node& lhs, const Node& rhs);
+bool operator!=(const Node& lhs, const Node& rhs);
+std::ostream& operator<<(std::ostream&, const Node&);
+std::ostream& operator<<(std::ostream&, const std::optional<Node>&);
+
+/**
+ * @brief Hash of a text (64-bit FNV-1a).
+ *
+ * Node::text_hash returns the same hash for the text of a node, so this can be
+ * used to look up nodes by their text (e.g. identifiers) without copying it.
+ */
+std::uint64_t text_hash(std::string_view text);
+
+/**
+ * @brief Single-pass range over the children of a Node.
+ *
+ * Created by Node::child_range, Node::named_child_range and
+ * Node::field_child_range. The children are
+ * visited with a tree cursor, so iterating over all children takes linear time
+ * and only the cursor allocates once (for any number of children).
+ *
+ * The iterators are input iterators: all iterators of a range share its
+ * cursor, so incrementing one moves all of them. Use it in a range-based for
+ * loop or with algorithms that only iterate once.
+ *
+ * \note The range is only valid as long as the node.
+ */
+class ChildRange {
+    TSTreeCursor cursor;
+    const Tree* tree;
+    bool named_only;
+    // 0 for children with any (or no) field
+    FieldId field;
+    bool at_end;
+
+    // moves the cursor to the next child that is part of the range
+    void skip_filtered();
+
+public:
+    class iterator {
+        // nullptr for the end iterator
+        ChildRange* range;
+
+        [[nodiscard]] bool at_end() const noexcept;
+
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = Node;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Node;
+
+        explicit iterator(ChildRange* range) noexcept;
+
+        Node operator*() const;
+
+        /**
+         * @brief The FieldId of the current child (0 if it has no field).
+         */
+        [[nodiscard]] FieldId field_id() const;
+
+        /**
+         * @brief The child an iterator pointed to before it was incremented
+         * (so `*it++` works like for other input iterators).
+         */
+        class PostfixProxy {
+            Node node;
+
+        public:
+            explicit PostfixProxy(Node node) noexcept;
+            Node operator*() const noexcept;
+        };
+
+        iterator& operator++();
+        PostfixProxy operator++(int);
+
+        friend bool operator==(const iterator&, const iterator&) noexcept;
+        friend bool operator!=(const iterator&, const iterator&) noexcept;
+    };
+
+    /**
+     * @brief Range over the children of `parent`.
+     *
+     * Only the named children if `named_only` is true and only the children
+     * with the given field if `field` is set (the range is empty for FieldId
+     * 0 because children without a field have that id).
+     */
+    ChildRange(
+        const Node& parent, bool named_only, std::optional<FieldId> field = std::nullopt);
+
+    ChildRange(const ChildRange&) = delete;
+    ChildRange& operator=(const ChildRange&) = delete;
+    ChildRange(ChildRange&&) = delete;
+    ChildRange& operator=(ChildRange&&) = delete;
+
+    ~ChildRange();
+
+    /**
+     * @brief Iterator to the current child (the first child if nothing was
+     * iterated yet).
+     */
+    iterator begin() noexcept;
+    iterator end() noexcept;
+};
+
+/**
+ * @brief Decides if edits are reparsed incrementally or from scratch.
+ *
+ * Reparsing incrementally has to apply every edit to the old tree and compare
+ * the old and new tree afterwards. If the edits touch most of a large source
+ * code this is slower than parsing it again without the old tree.
+ *
+ * The touched bytes are the replaced bytes plus the inserted bytes of all
+ * edits (so replacing the whole source code touches at least all of it).
+ *
+ * The policy is only used if it is set in EditOptions::reparse_policy.
+ */
+struct ReparsePolicy {
+    /**
+     * @brief Always reparse incrementally if the old source code is smaller
+     * than this.
+     *
+     * Small source codes are reparsed quickly either way and incremental
+     * reparses report narrow EditResult::changed_ranges.
+     */
+    std::size_t min_source_size = 64 * 1024;
+    /**
+     * @brief Reparse from scratch if there are more edits than this.
+     */
+    std::size_t max_incremental_edits = 4096;
+    /**
+     * @brief Reparse from scratch if the edits touch more than this fraction
+     * of the old source code.
+     */
+    double max_touched_fraction = 0.5;
+
+    /**
+     * @brief If edits should be reparsed from scratch.
+     */
+    [[nodiscard]] bool full_reparse(
+        std::size_t edit_count, std::size_t touched_bytes, std::size_t source_size) const;
+};
+
+/**
+ * @brief Counts how edits were reparsed (see EditOptions::reparse_statistics).
+ */
+struct ReparseStatistics {
+    std::uint64_t incremental_reparses = 0;
+    std::uint64_t full_reparses = 0;
+};
+
+/**
+ * @brief Parser for a Tree-Sitter language.
+ *
+ * The default constructor uses @ref LUA_LANGUAGE.
+ *
+ * Features not included (because we currently don't use them):
+ *
+ * - Grammar debug features:
+ *   - `ts_parser_set_logger`
+ *   - `ts_parser_logger`
+ *   - `ts_parser_print_dot_graphs`
+ */
+class Parser {
+    std::unique_ptr<TSParser, void (*)(TSParser*)> parser;
+    // not owned pointer (only set if the parser belongs to a pool)
+    ParserPool* pool_ = nullptr;
+
+    friend class ParserPool;
+
+public:
+    /**
+     * @brief Create a parser using the given language.
+     */
+    Parser(const Language&);
+
+    /**
+     * @brief Returns the raw Tree-Sitter parser.
+     *
+     * \warning
+     * Use with care. Only intended vor internal use in the wrapper types.
+     *
+     * \warning
+     * Never free or otherwise delete this pointer.
+     */
+    [[nodiscard]] TSParser* raw() const;
+
+    /**
+     * @brief The Language the parser was created from.
+     */
+    [[nodiscard]] Language language() const;
+
+    /**
+     * @brief The ParserPool this parser belongs to.
+     *
+     * Returns `nullptr` if the parser was not created by a ParserPool.
+     */
+    [[nodiscard]] ParserPool* pool() const;
+
+    /**
+     * @brief Set the maximum duration in microseconds that parsing is allowed
+     * to take before it is halted.
+     *
+     * `0` (the default) disables the timeout. If the timeout is reached the
+     * parse methods throw ParseFailureException. Use ParseTask to resume
+     * parsing instead.
+     *
+     * \note Tree::edit ignores the timeout and always finishes reparsing.
+     */
+    void set_timeout_micros(std::uint64_t timeout);
+
+    /**
+     * @brief The timeout set with Parser::set_timeout_micros.
+     */
+    [[nodiscard]] std::uint64_t timeout_micros() const;
+
+    /**
+     * @brief Set the flag the parser periodically checks during parsing.
+     *
+     * If the flag is set to a non-zero value parsing is halted. The parse
+     * methods then throw ParseFailureException. Use ParseTask to resume
+     * parsing instead. Pass `nullptr` to remove the flag.
+     *
+     * The flag can be set from another thread and has to outlive the parser
+     * (or be removed before it is destructed).
+     *
+     * \note Tree::edit ignores the flag and always finishes reparsing.
+     */
+    void set_cancellation_flag(const std::atomic<std::size_t>* flag);
+
+    /**
+     * @brief The flag set with Parser::set_cancellation_flag.
+     */
+    [[nodiscard]] const std::atomic<std::size_t>* cancellation_flag() const;
+
+    /**
+     * @brief Discard the state of a halted parse.
+     *
+     * After a timeout or cancellation the parser would otherwise try to
+     * resume the previous parse on the next call.
+     */
+    void reset() const;
+
+    /**
+     * @brief Only parse the given ranges of the source code.
+     *
+     * All following parses treat the text in the ranges as one document and
+     * skip everything else (but the byte offsets and points of the nodes are
+     * still relative to the whole source code). This can be used to parse
+     * code that is embedded in another language.
+     *
+     * The ranges have to be sorted and must not overlap, otherwise
+     * IncludedRangesException is thrown. An empty vector parses the whole
+     * source code again.
+     */
+    void set_included_ranges(const std::vector<Range>&);
+
+    /**
+     * @brief The ranges set with Parser::set_included_ranges.
+     *
+     * If no ranges were set this returns one range that covers the whole
+     * source code.
+     */
+    [[nodiscard]] std::vector<Range> included_ranges() const;
+
+    /**
+     * @brief Parse a string and return its syntax tree.
+     *
+     * This takes the source code by copy (or move) and stores it in the tree.
+     */
+    Tree parse_string(std::string) const;
+
+    /**
+     * @brief Parse a string and return its syntax tree.
+     *
+     * This takes the source code by copy (or move) and a previously parsed tree.
+     *
+     * \note Only for internal use.
+     */
+    Tree parse_string(const TSTree* old_tree, std::string source) const;
+
+    /**
+     * @brief Parse a Source and return its syntax tree.
+     *
+     * The tree only keeps a reference to the source code. Depending on how
+     * the Source was created this either shares ownership of the buffer or
+     * only borrows it (see Source::borrow). In no case is the text copied.
+     */
+    Tree parse_source(Source) const;
+
+    /**
+     * @brief Parse a Source and return its syntax tree.
+     *
+     * This takes the Source and a previously parsed tree.
+     *
+     * \note Only for internal use.
+     */
+    Tree parse_source(const TSTree* old_tree, Source source) const;
+
+    /**
+     * @brief Parse a file and return its syntax tree.
+     *
+     * The file is mapped into memory (see Source::map_file) and parsed
+     * directly from the mapping. The tree keeps the mapping alive so
+     * Node::text works without ever copying the file contents.
+     *
+     * `path` has to be a null-terminated string (e.g. from a std::string).
+     *
+     * Throws FileException if the file can't be opened or mapped.
+     */
+    Tree parse_file(std::string_view path) const;
+
+    /**
+     * @brief Parse a UTF-16 string and return its syntax tree.
+     *
+     * The source code is parsed as UTF-16 without transcoding it. The tree
+     * stores a copy of it; to avoid the copy pass Source::utf16 (which takes
+     * ownership of a std::u16string) or Source::borrow_utf16 to
+     * Parser::parse_source. Use Node::text_utf16 to get the text of the nodes.
+     *
+     * \note Byte offsets and columns are counted in bytes (see
+     * Encoding::UTF16). The returned tree can be edited with Edit::utf16 or
+     * Tree::update_source.
+     */
+    Tree parse_string_utf16(std::u16string_view) const;
+
+    /**
+     * @brief Parse a PieceTable and return its syntax tree.
+     *
+     * The pieces are passed to Tree-Sitter in chunks (without joining them).
+     * The tree keeps the piece table and Tree::edit only edits the piece table
+     * instead of copying the source code. Use Node::for_each_chunk to get the
+     * text of large nodes without joining the pieces.
+     */
+    Tree parse_piece_table(PieceTable) const;
+
+    /**
+     * @brief Parse a PieceTable and return its syntax tree.
+     *
+     * This takes the PieceTable and a previously parsed tree.
+     *
+     * \note Only for internal use.
+     */
+    Tree parse_piece_table(const TSTree* old_tree, PieceTable pieces) const;
+
+    /**
+     * @brief Parse source code that is read in chunks by the given Reader.
+     *
+     * The source code is never copied into a contiguous string. Instead the
+     * tree keeps the Reader and Node::text reads the text of the node through
+     * it. So the Reader (and whatever it reads from) has to stay valid and
+     * unchanged for as long as the tree is used.
+     *
+     * Use the overload of Tree::edit that takes a Reader to edit the returned
+     * tree.
+     */
+    Tree parse(Reader) const;
+
+    /**
+     * @brief Parse source code that is read in chunks by the given Reader.
+     *
+     * This takes the Reader and a previously parsed tree.
+     *
+     * \note Only for internal use.
+     */
+    Tree parse(const TSTree* old_tree, Reader reader) const;
+};
+
+/**
+ * @brief A resumable parse of a Source.
+ *
+ * This is useful together with Parser::set_timeout_micros (or
+ * Parser::set_cancellation_flag) to parse big files in small time slices,
+ * e.g. on a UI thread:
+ *
+ * ```cpp
+ * parser.set_timeout_micros(2000);
+ * ts::ParseTask task(parser, source);
+ * // call this repeatedly (e.g. once per frame)
+ * if (std::optional<ts::Tree> tree = task.resume()) {
+ *     // done
+ * }
+ * ```
+ *
+ * If the task is destructed (or ParseTask::cancel is called) before it
+ * finished the parser is reset, so it can be used for other sources again.
+ * The parser can't be used for anything else while the task is not finished.
+ *
+ * Can only be moved.
+ */
+class ParseTask {
+    // not owned pointer
+    const Parser* parser;
+    Source source;
+    bool running = false;
+
+public:
+    /**
+     * @brief Create a task to parse `source` with `parser`.
+     *
+     * Parsing only starts when ParseTask::resume is called.
+     */
+    ParseTask(const Parser& parser, Source source) noexcept;
+    ~ParseTask();
+
+    ParseTask(const ParseTask&) = delete;
+    ParseTask& operator=(const ParseTask&) = delete;
+
+    /**
+     * @brief Move constructor.
+     */
+    ParseTask(ParseTask&&) noexcept;
+    /**
+     * @brief Move assignment operator.
+     */
+    ParseTask& operator=(ParseTask&&) noexcept;
+
+    /**
+     * @brief Start or continue parsing.
+     *
+     * Returns the tree if parsing finished or `std::nullopt` if it was halted
+     * by the timeout or cancellation flag of the parser. In the latter case
+     * calling this again continues where parsing was halted.
+     *
+     * After the tree was returned this must not be called again.
+     */
+    std::optional<Tree> resume();
+
+    /**
+     * @brief Check if parsing was started but is not finished yet.
+     */
+    [[nodiscard]] bool is_running() const;
+
+    /**
+     * @brief Abandon the parse and reset the parser.
+     */
+    void cancel();
+};
+
+/**
+ * @brief A Parser checked out from a ParserPool.
+ *
+ * Gives exclusive access to the parser and returns it to the pool when it is
+ * destructed.
+ *
+ * Can only be moved.
+ */
+class PooledParser {
+    // not owned pointers
+    ParserPool* pool;
+    Parser* parser;
+
+public:
+    /**
+     * @brief Wrap a parser checked out from the given pool.
+     *
+     * \warning Should only be used internally. Use ParserPool::checkout.
+     */
+    PooledParser(ParserPool& pool, Parser& parser) noexcept;
+    ~PooledParser();
+
+    PooledParser(const PooledParser&) = delete;
+    PooledParser& operator=(const PooledParser&) = delete;
+
+    /**
+     * @brief Move constructor.
+     */
+    PooledParser(PooledParser&&) noexcept;
+    /**
+     * @brief Move assignment operator.
+     */
+    PooledParser& operator=(PooledParser&&) noexcept;
+
+    /**
+     * @brief The checked out parser.
+     */
+    [[nodiscard]] Parser& get() const;
+    Parser& operator*() const;
+    Parser* operator->() const;
+};
+
+/**
+ * @brief Thread-safe pool of [Parser](@ref Parser)s for one Language.
+ *
+ * A Parser can't be used from multiple threads at the same time. Instead
+ * every thread checks out its own parser with ParserPool::checkout and
+ * returns it when the PooledParser is destructed. Parsers are only created
+ * when there is no idle parser and at most `max_size` parsers exist. If all
+ * of them are checked out ParserPool::checkout blocks until one is returned.
+ *
+ * Trees parsed by a pooled parser remember the pool and Tree::edit checks out
+ * a parser from the pool for the incremental reparse. So the pool has to
+ * outlive those trees.
+ *
+ * \warning Editing such a tree while the same thread holds all parsers of the
+ * pool will deadlock.
+ *
+ * Can't be copied or moved because the parsers keep a pointer to the pool.
+ */
+class ParserPool {
+    const Language language_;
+    const std::size_t max_size_;
+
+    mutable std::mutex mutex;
+    std::condition_variable returned;
+    // owns all parsers (the parsers are never moved)
+    std::vector<std::unique_ptr<Parser>> parsers;
+    std::vector<Parser*> idle;
+
+    friend class PooledParser;
+    void checkin(Parser&);
+
+public:
+    /**
+     * @brief Create an empty pool for the language.
+     *
+     * `max_size` is the maximum number of parsers the pool will create. If it
+     * is `0` the number of hardware threads is used.
+     */
+    explicit ParserPool(const Language&, std::size_t max_size = 0);
+
+    ParserPool(const ParserPool&) = delete;
+    ParserPool& operator=(const ParserPool&) = delete;
+    ParserPool(ParserPool&&) = delete;
+    ParserPool& operator=(ParserPool&&) = delete;
+
+    ~ParserPool() = default;
+
+    /**
+     * @brief The Language of the parsers.
+     */
+    [[nodiscard]] Language language() const;
+
+    /**
+     * @brief The maximum number of parsers.
+     */
+    [[nodiscard]] std::size_t max_size() const;
+
+    /**
+     * @brief The number of parsers created so far.
+     */
+    [[nodiscard]] std::size_t size() const;
+
+    /**
+     * @brief The number of parsers that are currently not checked out.
+     */
+    [[nodiscard]] std::size_t idle_count() const;
+
+    /**
+     * @brief Check out a parser for exclusive use.
+     *
+     * Blocks if all parsers are in use.
+     */
+    PooledParser checkout();
+
+    /**
+     * @brief Check out a parser for exclusive use if one is available.
+     *
+     * Returns `std::nullopt` instead of blocking if all parsers are in use.
+     */
+    std::optional<PooledParser> try_checkout();
+
+    /**
+     * @brief Parse a string with a parser from the pool.
+     *
+     * See Parser::parse_string.
+     */
+    Tree parse_string(std::string);
+
+    /**
+     * @brief Parse a Source with a parser from the pool.
+     *
+     * See Parser::parse_source.
+     */
+    Tree parse_source(Source);
+};
+
+/**
+ * @brief Holds information about an applied Edit.
+ *
+ * `after` could for example be used to highlight changed locations in an editor.
+ *
+ * Supports equality operators.
+ */
+struct AppliedEdit {
+    /**
+     * @brief The Range in the old source code string.
+     */
+    Range before;
+    /**
+     * @brief The Range in the new source code string.
+     */
+    Range after;
+    /**
+     * @brief The string in the old source code that was replaced.
+     *
+     * Empty if EditOptions::copy_old_source was disabled.
+     */
+    std::string old_source;
+    /**
+     * @brief The string that replaced the `old_source`.
+     */
+    std::string replacement;
+};
+
+bool operator==(const AppliedEdit&, const AppliedEdit&);
+bool operator!=(const AppliedEdit&, const AppliedEdit&);
+std::ostream& operator<<(std::ostream&, const AppliedEdit&);
+std::ostream& operator<<(std::ostream&, const std::vector<AppliedEdit>&);
+
+/**
+ * @brief Holds information about all applied edits.
+ *
+ * Returned by Tree::edit.
+ *
+ * Supports equality operators.
+ */
+struct EditResult {
+    /**
+     * @brief The raw ranges of string that were changed.
+     *
+     * This does not directly correspond to the edits.
+     */
+    std::vector<Range> changed_ranges;
+    /**
+     * @brief The adjusted and applied edits.
+     *
+     * Holds information about the actually applied edits, including adjusted
+     * locations.
+     */
+    std::vector<AppliedEdit> applied_edits;
+};
+
+bool operator==(const EditResult&, const EditResult&);
+bool operator!=(const EditResult&, const EditResult&);
+std::ostream& operator<<(std::ostream&, const EditResult&);
+
+/**
+ * @brief Options for Tree::edit.
+ */
+struct EditOptions {
+    /**
+     * @brief Copy the replaced text into AppliedEdit::old_source.
+     *
+     * This allocates a string for every edit. If the replaced text is not
+     * needed (or only for a few edits) disable this and read it from a copy
+     * of the tree made before the edit instead (copies are cheap), e.g.
+     * `old_tree.text(applied_edit.before.start.byte, applied_edit.before.end.byte)`.
+     * AppliedEdit::old_source is then empty.
+     */
+    bool copy_old_source = true;
+
+    /**
+     * @brief Decides if the edits are reparsed incrementally or from scratch.
+     *
+     * Without a policy the edits are always reparsed incrementally. Both
+     * produce the same tree and EditResult::applied_edits, but after a full
+     * reparse EditResult::changed_ranges contains one range that covers the
+     * whole tree.
+     */
+    std::optional<ReparsePolicy> reparse_policy = std::nullopt;
+
+    /**
+     * @brief Counts how the edits were reparsed (not owned, nullptr to not
+     * count them).
+     *
+     * Pass the same statistics to multiple edits to aggregate them. They
+     * are not synchronized, so they can't be shared by edits in different
+     * threads.
+     */
+    ReparseStatistics* reparse_statistics = nullptr;
+};
+
+/**
+ * @brief Byte offsets of the starts of all lines in the source code.
+ *
+ * This can be used to convert between byte offsets and points without
+ * scanning the source code. Every Tree keeps one (see Tree::line_index) and
+ * Tree::edit updates it using only the edits.
  */
-struct AppliedEdit {
+class LineIndex {
+    // always starts with 0 (the start of the first line)
+    std::vector<std::uint32_t> line_starts_;
+    Encoding encoding_ = Encoding::UTF8;
+
+    LineIndex() = default;
+
+public:
+    /**
+     * @brief Index the lines of the given source code.
+     *
+     * For UTF-16 source code `source` are the raw bytes (see
+     * Encoding::UTF16).
+     */
+    explicit LineIndex(std::string_view source, Encoding encoding = Encoding::UTF8);
+
+    /**
+     * @brief Index the lines of the source code read by the Reader.
+     */
+    explicit LineIndex(const Reader& reader, Encoding encoding = Encoding::UTF8);
+
+    /**
+     * @brief The index for the source code after the given edits.
+     *
+     * The edits have to be sorted and their AppliedEdit::before range has to
+     * refer to the source code of this index (e.g. from
+     * EditResult::applied_edits). This only looks at the line starts and the
+     * replacements and not at the rest of the source code.
+     */
+    [[nodiscard]] LineIndex edited(const std::vector<AppliedEdit>& edits) const;
+
+    /**
+     * @brief The byte offsets of the first character of every line.
+     */
+    [[nodiscard]] const std::vector<std::uint32_t>& line_starts() const;
+
+    /**
+     * @brief The number of lines (always at least one).
+     */
+    [[nodiscard]] std::size_t line_count() const;
+
+    /**
+     * @brief The Point of the given byte offset.
+     */
+    [[nodiscard]] Point point(std::uint32_t byte) const;
+
+    /**
+     * @brief The Location of the given byte offset.
+     */
+    [[nodiscard]] Location location(std::uint32_t byte) const;
+};
+
+/**
+ * @brief Immutable source code stored as a sequence of pieces.
+ *
+ * Each piece is a Source that shares (a part of) a buffer. Editing a piece
+ * table creates a new one that reuses the unchanged buffers, so the cost of
+ * an edit depends on the number of pieces and not on the size of the source
+ * code. Copying a piece table only copies the pieces (never the text).
+ *
+ * Use Parser::parse_piece_table to parse a piece table. The tree then edits
+ * the piece table instead of copying the whole source code (see Tree::edit).
+ *
+ * If a piece table gets too fragmented by edits it is flattened into one
+ * piece again.
+ */
+class PieceTable {
+    std::vector<Source> pieces_;
+    // the encoding of all pieces
+    Encoding encoding_ = Encoding::UTF8;
+    // byte offset of the start of every piece
+    std::vector<std::uint32_t> piece_starts_;
+    std::uint32_t size_ = 0;
+
+    void push_back(Source piece);
+
+public:
+    /**
+     * @brief Create an empty piece table.
+     */
+    PieceTable() = default;
+
+    /**
+     * @brief Create a piece table with one piece.
+     */
+    explicit PieceTable(Source source);
+
+    /**
+     * @brief Size of the source code in bytes.
+     */
+    [[nodiscard]] std::uint32_t size() const;
+
+    /**
+     * @brief The encoding of the source code (the encoding of the Source it
+     * was created from).
+     */
+    [[nodiscard]] Encoding encoding() const;
+
+    /**
+     * @brief The pieces that make up the source code.
+     */
+    [[nodiscard]] const std::vector<Source>& pieces() const;
+
+    /**
+     * @brief The rest of the piece that contains the given byte offset.
+     *
+     * Returns an empty view if `byte` is not inside the source code. This can
+     * be used as a Reader. Finding the piece takes O(log pieces).
+     */
+    [[nodiscard]] std::string_view chunk(std::uint32_t byte) const;
+
+    /**
+     * @brief The source code between the two byte offsets.
+     */
+    [[nodiscard]] std::string text(std::uint32_t start_byte, std::uint32_t end_byte) const;
+
+    /**
+     * @brief The piece table after the given edits.
+     *
+     * The edits have to be sorted and their AppliedEdit::before range has to
+     * refer to the source code of this piece table (e.g. from
+     * EditResult::applied_edits). All replacements are stored in one new
+     * buffer.
+     */
+    [[nodiscard]] PieceTable edited(const std::vector<AppliedEdit>& edits) const;
+};
+
+/**
+ * @brief Ranges (e.g. diagnostics or bookmarks) that are moved along with
+ * edits of the source code.
+ *
+ * Every anchor is identified by the id returned from AnchorSet::add. The
+ * starts and ends of all anchors are kept sorted, so AnchorSet::rebase only
+ * touches the anchors at or after the first edit.
+ *
+ * A location inside of a replaced range is moved to the start of the
+ * replacement if it is the start of an anchor and to the end of the
+ * replacement if it is the end of an anchor. Insertions at the start of an
+ * anchor are not included in the anchor, insertions at its end are.
+ *
+ * Trees keep an AnchorSet that is rebased by Tree::edit (see
+ * Tree::add_anchor).
+ */
+class AnchorSet {
+public:
+    using Id = std::uint32_t;
+
+private:
+    struct Endpoint {
+        Id anchor;
+        bool is_start;
+    };
+
+    // indexed by id (removed anchors are empty)
+    std::vector<std::optional<Range>> anchors_;
+    // sorted by the byte of their location
+    std::vector<Endpoint> endpoints_;
+    std::size_t size_ = 0;
+
+    [[nodiscard]] Location& location(const Endpoint&);
+    [[nodiscard]] const Location& location(const Endpoint&) const;
+    void insert(Endpoint);
+    void erase(Endpoint);
+
+public:
+    /**
+     * @brief Add an anchor for the range and return its id.
+     *
+     * Ids are not reused after an anchor is removed.
+     */
+    Id add(Range);
+
+    /**
+     * @brief Remove the anchor with the given id.
+     *
+     * Does nothing if there is no such anchor.
+     */
+    void remove(Id);
+
+    /**
+     * @brief The current range of the anchor with the given id.
+     *
+     * Returns `std::nullopt` if there is no such anchor.
+     */
+    [[nodiscard]] std::optional<Range> range(Id) const;
+
+    /**
+     * @brief The number of anchors.
+     */
+    [[nodiscard]] std::size_t size() const;
+
+    /**
+     * @brief Move the anchors along with the edits.
+     *
+     * The edits have to be sorted and their AppliedEdit::before range has to
+     * refer to the current locations of the anchors (e.g. from
+     * EditResult::applied_edits).
+     */
+    void rebase(const std::vector<AppliedEdit>& edits);
+};
+
+/**
+ * @brief A syntax tree.
+ *
+ * This also references the source code (see Source) to allow the nodes to
+ * refer to the text they were created from.
+ */
+class Tree {
+    std::unique_ptr<TSTree, void (*)(TSTree*)> tree;
+    Source source_;
+    // only set if the tree was created by Parser::parse (shared between copies)
+    std::shared_ptr<const Reader> reader_;
+    // only set if the tree was created by Parser::parse_piece_table (then
+    // reader_ reads from it)
+    std::shared_ptr<const PieceTable> pieces_;
+    // created lazily by Tree::line_index (shared between copies)
+    mutable std::shared_ptr<const LineIndex> line_index_;
+    // created by Tree::add_anchor (shared between copies until one of them
+    // changes its anchors)
+    std::shared_ptr<AnchorSet> anchors_;
+
+    // not owned pointer
+    const Parser* parser_;
+
+    friend class PendingEdits;
+    AnchorSet& unique_anchors();
+
+    // the raw bytes of the source code (in any encoding), see Tree::for_each_chunk
+    void for_each_byte_chunk(
+        std::uint32_t start_byte, std::uint32_t end_byte,
+        const std::function<void(std::string_view)>& fn) const;
+    // the raw bytes of the source code without copying them, see Tree::text_view
+    [[nodiscard]] std::string_view
+    byte_view(std::uint32_t start_byte, std::uint32_t end_byte) const;
+
+public:
+    /**
+     * @brief Create a new tree from the raw Tree-Sitter tree.
+     *
+     * \warning Should only be used internally. This class handles the TSTree
+     * pointer as a reference. Calling this twice with the same pointer will
+     * lead to double-frees.
+     */
+    explicit Tree(TSTree* tree, Source source, const Parser& parser);
+
+    /**
+     * @brief Create a new tree from the raw Tree-Sitter tree that was parsed
+     * using the Reader.
+     *
+     * \warning Should only be used internally. See the other constructor.
+     */
+    explicit Tree(TSTree* tree, Reader reader, const Parser& parser);
+
+    /**
+     * @brief Create a new tree from the raw Tree-Sitter tree that was parsed
+     * from the PieceTable.
+     *
+     * \warning Should only be used internally. See the other constructor.
+     */
+    explicit Tree(TSTree* tree, std::shared_ptr<const PieceTable> pieces, const Parser& parser);
+
+    /**
+     * @brief Copy constructor.
+     *
+     * This is O(1) in time and memory: `TSTree*` can be safely (and fast)
+     * copied using `ts_tree_copy` and the copy shares the immutable source code
+     * (or Reader) with this tree. So copies can be used as snapshots e.g. for
+     * a background thread.
+     *
+     * Editing a tree never modifies the shared source code. Instead the edited
+     * tree gets a new Source and all copies keep the old one.
+     */
+    Tree(const Tree&);
+    /**
+     * @brief Copy assignment operator.
+     */
+    Tree& operator=(const Tree&);
+
+    /**
+     * @brief Move constructor.
+     */
+    Tree(Tree&& other) noexcept = default;
+    /**
+     * @brief Move assignment operator.
+     */
+    Tree& operator=(Tree&& other) noexcept = default;
+    /**
+     * @brief Swap function.
+     */
+    friend void swap(Tree& self, Tree& other) noexcept;
+
+    ~Tree() = default;
+
+    /**
+     * @brief Returns the raw Tree-Sitter tree.
+     *
+     * \warning
+     * Use with care. Only intended vor internal use in the wrapper types.
+     *
+     * \warning
+     * Never free or otherwise delete this pointer.
+     */
+    [[nodiscard]] const TSTree* raw() const;
+
+    /**
+     * @brief The source code the tree was created from.
+     *
+     * The returned view is valid for as long as the tree is not edited or
+     * destructed (or as long as the borrowed string is alive for trees created
+     * from Source::borrow).
+     *
+     * This is empty if the tree was created with Parser::parse or
+     * Parser::parse_piece_table.
+     */
+    [[nodiscard]] std::string_view source() const;
+
+    /**
+     * @brief Check if the tree was created with Parser::parse (or
+     * Parser::parse_piece_table) and reads its source code through a Reader.
+     */
+    [[nodiscard]] bool has_reader() const;
+
+    /**
+     * @brief The PieceTable the tree was created from.
+     *
+     * This is `nullptr` if the tree was not created with
+     * Parser::parse_piece_table.
+     */
+    [[nodiscard]] const PieceTable* piece_table() const;
+
+    /**
+     * @brief The Source the tree refers to.
+     *
+     * This can be used to parse other trees from the same buffer without
+     * copying it. It is empty if the tree was created with Parser::parse.
+     */
+    [[nodiscard]] const Source& source_buffer() const;
+
+    /**
+     * @brief The source code between the two byte offsets.
+     *
+     * This also works for trees created with Parser::parse.
+     *
+     * Throws EncodingException if the tree was parsed from UTF-16 source code.
+     */
+    [[nodiscard]] std::string text(std::uint32_t start_byte, std::uint32_t end_byte) const;
+
+    /**
+     * @brief The source code between the two byte offsets without copying
+     * it.
+     *
+     * For trees created with Parser::parse_piece_table this only works if the
+     * text is inside of one piece.
+     *
+     * Throws TextViewException if the text is not stored in one string and
+     * EncodingException if the tree was parsed from UTF-16 source code.
+     */
+    [[nodiscard]] std::string_view
+    text_view(std::uint32_t start_byte, std::uint32_t end_byte) const;
+
+    /**
+     * @brief Call `fn` with the chunks of source code between the two byte
+     * offsets (in order) without copying them.
+     *
+     * For trees with a source code string this is only one chunk. The chunks
+     * are only valid during the call of `fn`.
+     *
+     * Throws EncodingException if the tree was parsed from UTF-16 source code.
+     */
+    void for_each_chunk(
+        std::uint32_t start_byte, std::uint32_t end_byte,
+        const std::function<void(std::string_view)>& fn) const;
+
+    /**
+     * @brief The UTF-16 source code between the two byte offsets.
+     *
+     * This also works for trees created with Parser::parse_piece_table.
+     *
+     * Throws EncodingException if the tree was not parsed from UTF-16 source
+     * code.
+     */
+    [[nodiscard]] std::u16string text_utf16(std::uint32_t start_byte, std::uint32_t end_byte) const;
+
+    /**
+     * @brief The UTF-16 source code between the two byte offsets without
+     * copying it.
+     *
+     * Same restrictions as Tree::text_view. Throws TextViewException if the
+     * text is not stored in one string and EncodingException if the tree was
+     * not parsed from UTF-16 source code.
+     */
+    [[nodiscard]] std::u16string_view
+    text_utf16_view(std::uint32_t start_byte, std::uint32_t end_byte) const;
+
+    /**
+     * @brief The line index of the source code.
+     *
+     * It is created on the first call (which scans the source code once) and
+     * afterwards updated incrementally by Tree::edit.
+     *
+     * For trees parsed from UTF-16 source code the offsets are in bytes (see
+     * Encoding::UTF16).
+     */
+    [[nodiscard]] const LineIndex& line_index() const;
+
+    /**
+     * @brief Add an anchor for the range that is moved along with every
+     * Tree::edit (see AnchorSet).
+     *
+     * The anchors are copied with the tree (only when one of the copies
+     * changes its anchors).
+     */
+    AnchorSet::Id add_anchor(Range);
+
+    /**
+     * @brief Remove an anchor added with Tree::add_anchor.
+     */
+    void remove_anchor(AnchorSet::Id);
+
+    /**
+     * @brief The anchors of the tree.
+     */
+    [[nodiscard]] const AnchorSet& anchors() const;
+
+    /**
+     * @brief The used parser.
+     *
+     * \note If the parser belongs to a ParserPool it might be in use by
+     * another thread. Check out a parser from Parser::pool instead of using
+     * it directly.
+     */
+    [[nodiscard]] const Parser& parser() const;
+
+    /**
+     * @brief The root node of the tree.
+     *
+     * The returned node is only valid as long as this tree is not destructed.
+     */
+    [[nodiscard]] Node root_node() const;
+
+    /**
+     * @brief The language that was used to parse the syntax tree.
+     */
+    [[nodiscard]] Language language() const;
+
+    /**
+     * @brief Edit the syntax tree and source code and return the changed ranges.
+     *
+     * You need to specify all edits you want to apply to the syntax tree in
+     * one call. Because this method changes both the syntax tree and source
+     * code string any other [Edit](@ref Edit)s will be invalid and trying to
+     * apply them is undefined behaviour.
+     *
+     * The edits can't be duplicate or overlapping. They can span multiple
+     * lines and the replacements can contain newlines. An edit with an empty
+     * range inserts its replacement and an empty replacement deletes the
+     * range. Multiple insertions at the same location are applied in the
+     * given order.
+     *
+     * The points of edits created with Edit::from_bytes are computed using
+     * Tree::line_index.
+     *
+     * The returned result contains information about the raw string ranges
+     * that changed and it also contains the adjusted location of the edits that
+     * can e.g. be used for highlighting in an editor.
+     *
+     * Any previously retrieved nodes will become (silently) invalid.
+     *
+     * \note This takes the edits by value because they should not be used after
+     * calling this function and we need to modify the vector internally.
+     *
+     * Trees created with Parser::parse_piece_table only edit their PieceTable
+     * instead of copying the source code.
+     *
+     * Trees parsed from UTF-16 source code can be edited too. The ranges are
+     * in bytes of the UTF-16 source code (see Encoding::UTF16) and the
+     * replacements are the raw bytes of the new text (see Edit::utf16).
+     *
+     * Throws MissingSourceException if the tree was created with
+     * Parser::parse.
+     *
+     * If the tree was created by a pooled parser (see ParserPool) a parser is
+     * checked out from the pool for reparsing.
+     *
+     * With EditOptions::reparse_policy the tree is reparsed from scratch
+     * instead of incrementally if the edits touch most of the source code.
+     *
+     * Disable EditOptions::copy_old_source for large batches of edits if the
+     * replaced text is not needed.
+     */
+    EditResult edit(std::vector<Edit>, EditOptions options = {});
+
     /**
-     * @brief The Range in the old source code string.
+     * @brief Edit the syntax tree of a tree created with Parser::parse.
+     *
+     * Same as the other overload but the edits have to be already applied to
+     * the source code that `new_source` reads. The tree is then reparsed
+     * using `new_source` and keeps it for Node::text.
+     *
+     * Because the old source code is not available anymore
+     * AppliedEdit::old_source will be empty (EditOptions::copy_old_source is
+     * ignored).
      */
-    Range before;
+    EditResult edit(std::vector<Edit>, Reader new_source, EditOptions options = {});
+
     /**
-     * @brief The Range in the new source code string.
+     * @brief Replace the source code and reparse the tree incrementally.
+     *
+     * This computes the edits from the old to the new source code (see
+     * diff_edits) and applies them with Tree::edit. So clients that only
+     * have the whole new source code still get an incremental reparse and
+     * the changed ranges.
+     *
+     * If the source code did not change the tree is not reparsed and the
+     * result is empty.
+     *
+     * The options are passed to Tree::edit, e.g. to reparse from scratch if
+     * most of the source code changed (see EditOptions::reparse_policy).
+     *
+     * Throws MissingSourceException if the tree was created with
+     * Parser::parse and EncodingException if it was parsed from UTF-16
+     * source code (use the std::u16string_view overload).
      */
-    Range after;
+    EditResult update_source(std::string_view new_source, EditOptions options = {});
+
     /**
-     * @brief The string in the old source code that was replaced.
+     * @brief Replace the UTF-16 source code and reparse the tree
+     * incrementally.
+     *
+     * Same as the other overload but for trees parsed from UTF-16 source
+     * code. Throws EncodingException if the tree was not parsed from UTF-16
+     * source code.
      */
-    std::string old_source;
+    EditResult update_source(std::u16string_view new_source, EditOptions options = {});
+
     /**
-     * @brief The string that replaced the `old_source`.
+     * @brief Print a dot graph to the given file.
+     *
+     * `file` has to be a null-terminated string (e.g. from a std::string).
      */
-    std::string replacement;
+    void print_dot_graph(std::string_view file) const;
 };
 
-bool operator==(const AppliedEdit&, const AppliedEdit&);
-bool operator!=(const AppliedEdit&, const AppliedEdit&);
-std::ostream& operator<<(std::ostream&, const AppliedEdit&);
-std::ostream& operator<<(std::ostream&, const std::vector<AppliedEdit>&);
+/**
+ * @brief Compute a small set of edits that turns `old_source` into
+ * `new_source`.
+ *
+ * The common prefix and suffix are skipped and the rest is compared line by
+ * line (using Myers' diff algorithm). Inside of changed lines only the
+ * changed characters are replaced. If too many lines changed the whole
+ * changed part is replaced by one edit.
+ *
+ * The edits are created with Edit::from_bytes and sorted.
+ */
+std::vector<Edit> diff_edits(std::string_view old_source, std::string_view new_source);
 
 /**
- * @brief Holds information about all applied edits.
+ * @brief Compute a small set of edits that turns the UTF-16 `old_source`
+ * into `new_source`.
  *
- * Returned by Tree::edit.
+ * Same as the other overload but the ranges of the edits are in bytes of the
+ * UTF-16 source code (see Encoding::UTF16).
+ */
+std::vector<Edit> diff_edits(std::u16string_view old_source, std::u16string_view new_source);
+
+/**
+ * @brief The ranges whose syntactic structure changed between an edited old
+ * tree and the reparsed new tree (see `ts_tree_get_changed_ranges`).
+ */
+std::vector<Range> get_changed_ranges(const TSTree* old_tree, const TSTree* new_tree);
+
+EditResult edit_tree(
+    std::vector<Edit> edits, Tree& tree, TSTree* old_tree, const Parser& parser,
+    EditOptions options = {});
+EditResult edit_tree(
+    std::vector<Edit> edits, Tree& tree, TSTree* old_tree, const Parser& parser,
+    Reader new_source, EditOptions options = {});
+EditResult edit_tree(
+    std::vector<Edit> edits, Tree& tree, TSTree* old_tree, const Parser& parser,
+    const PieceTable& old_source, EditOptions options = {});
+
+/**
+ * @brief Apply the edits to the raw tree (see `ts_tree_edit`) and the
+ * PieceTable without reparsing.
+ */
+std::vector<AppliedEdit> apply_edits(
+    std::vector<Edit> edits, TSTree* tree, PieceTable& source, const EditOptions& options = {});
+/**
+ * @brief Reparse the edited `old_tree` using `new_source` and replace `tree`
+ * with the result.
  *
- * Supports equality operators.
+ * EditOptions::reparse_policy decides if the old tree is reused.
  */
-struct EditResult {
+EditResult reparse_tree(
+    Tree& tree, TSTree* old_tree, const Parser& parser, PieceTable new_source,
+    std::vector<AppliedEdit> applied_edits, const EditOptions& options = {});
+
+/**
+ * @brief Collects edits of a Tree and only reparses it when it is read.
+ *
+ * This is useful for editors that get one edit per keystroke: each call to
+ * PendingEdits::edit only updates the syntax tree with `ts_tree_edit` (which
+ * is cheap) and edits the source code. The first read through
+ * PendingEdits::tree or PendingEdits::root_node (e.g. to create a Cursor or
+ * execute a query) reparses the tree once for all pending edits.
+ *
+ * Unlike for Tree::edit each call to PendingEdits::edit takes edits for the
+ * source code after all previous calls (i.e. one call per keystroke).
+ *
+ * The source code is kept as a PieceTable so no edit copies the whole source
+ * code. So the tree is afterwards always a tree created with
+ * Parser::parse_piece_table.
+ *
+ * ```cpp
+ * ts::PendingEdits pending(parser.parse_string(source));
+ * pending.edit({edit1});
+ * pending.edit({edit2});
+ * // reparses once
+ * ts::Node root = pending.root_node();
+ * std::vector<ts::Range> changed = pending.last_result().changed_ranges;
+ * ```
+ */
+class PendingEdits {
+    Tree tree_;
+    // the source code with all pending edits
+    PieceTable source_;
+    // copy of the tree with all pending edits (nullptr if there are none)
+    std::unique_ptr<TSTree, void (*)(TSTree*)> edited_tree_;
+    std::vector<AppliedEdit> pending_;
+    // only created if it is needed for Edit::from_bytes
+    std::optional<LineIndex> line_index_;
+    EditResult last_result_;
+    EditOptions options_;
+
+public:
     /**
-     * @brief The raw ranges of string that were changed.
+     * @brief Collect edits for the given tree.
      *
-     * This does not directly correspond to the edits.
+     * The options are used for all edits and reparses (see Tree::edit).
+     *
+     * Throws MissingSourceException if the tree was created with
+     * Parser::parse.
      */
-    std::vector<Range> changed_ranges;
+    explicit PendingEdits(Tree tree, EditOptions options = {});
+
     /**
-     * @brief The adjusted and applied edits.
+     * @brief Apply the edits without reparsing the tree.
      *
-     * Holds information about the actually applied edits, including adjusted
-     * locations.
+     * The edits refer to the source code after all previous edits. The
+     * requirements for the edits are the same as for Tree::edit.
+     *
+     * Returns the applied edits.
      */
-    std::vector<AppliedEdit> applied_edits;
-};
+    std::vector<AppliedEdit> edit(std::vector<Edit>);
 
-bool operator==(const EditResult&, const EditResult&);
-bool operator!=(const EditResult&, const EditResult&);
-std::ostream& operator<<(std::ostream&, const EditResult&);
+    /**
+     * @brief Check if there are edits that were not yet reparsed.
+     */
+    [[nodiscard]] bool has_pending() const;
 
-/**
- * @brief A syntax tree.
- *
- * This also contains a copy of the source code to allow the nodes to refer to
- * the text they were created from.
- */
-class Tree {
-    std::unique_ptr<TSTree, void (*)(TSTree*)> tree;
-    // maybe a separate Input type is better to be more flexible
-    std::string source_;
+    /**
+     * @brief The source code with all edits.
+     */
+    [[nodiscard]] const PieceTable& source() const;
 
-    // not owned pointer
-    const Parser* parser_;
+    /**
+     * @brief The anchors of the tree (see Tree::add_anchor) moved along with
+     * all edits, including the pending ones.
+     */
+    [[nodiscard]] const AnchorSet& anchors() const;
 
-public:
     /**
-     * @brief Create a new tree from the raw Tree-Sitter tree.
+     * @brief Reparse the tree if there are pending edits.
      *
-     * \warning Should only be used internally. This class handles the TSTree
-     * pointer as a reference. Calling this twice with the same pointer will
-     * lead to double-frees.
+     * The returned result contains the changed ranges of all pending edits
+     * together and all applied edits in the order they were applied (each
+     * refers to the source code after the previous edits). If there are no
+     * pending edits the result is empty.
      */
-    explicit Tree(TSTree* tree, std::string source, const Parser& parser);
+    EditResult flush();
 
     /**
-     * @brief Copy constructor.
+     * @brief The result of the last reparse (see PendingEdits::flush).
+     */
+    [[nodiscard]] const EditResult& last_result() const;
+
+    /**
+     * @brief The tree with all edits (reparses if necessary).
      *
-     * `TSTree*` can be safely (and fast) copied using `ts_tree_copy`.
+     * The returned reference is valid as long as this object exists.
      */
-    Tree(const Tree&);
+    const Tree& tree();
+
     /**
-     * @brief Copy assignment operator.
+     * @brief The root node of the tree with all edits (reparses if necessary).
+     *
+     * The returned node is only valid until the next edit.
      */
-    Tree& operator=(const Tree&);
+    Node root_node();
+};
 
+/**
+ * @brief Options for parse_many.
+ */
+struct ParseManyOptions {
     /**
-     * @brief Move constructor.
+     * @brief The maximum number of threads (including the calling thread).
+     *
+     * If this is `0` ParserPool::max_size is used. Fewer threads are used if
+     * there are fewer sources or not enough idle parsers in the pool.
      */
-    Tree(Tree&& other) noexcept = default;
+    std::size_t threads = 0;
     /**
-     * @brief Move assignment operator.
+     * @brief Optional flag to cancel the remaining work.
+     *
+     * If it is set to a non-zero value no new sources are parsed and the
+     * parses in progress are halted (the flag is installed on the parsers with
+     * Parser::set_cancellation_flag while they are used). Sources that were
+     * already parsed are still returned.
      */
-    Tree& operator=(Tree&& other) noexcept = default;
+    const std::atomic<std::size_t>* cancelled = nullptr;
+};
+
+/**
+ * @brief Result of parsing one source with parse_many.
+ *
+ * Exactly one of the following is true:
+ *
+ * - `tree` is set if the source was parsed
+ * - `error` is set if parsing the source failed
+ * - neither is set if parse_many was cancelled before the source was parsed
+ */
+struct ParseResult {
     /**
-     * @brief Swap function.
+     * @brief The parsed tree.
      */
-    friend void swap(Tree& self, Tree& other) noexcept;
+    std::optional<Tree> tree;
+    /**
+     * @brief The exception thrown while parsing the source.
+     */
+    std::exception_ptr error;
 
-    ~Tree() = default;
+    /**
+     * @brief Check if the source was skipped because parse_many was cancelled.
+     */
+    [[nodiscard]] bool cancelled() const;
+};
+
+/**
+ * @brief Parse many sources in parallel.
+ *
+ * The sources are parsed by multiple threads (see ParseManyOptions::threads)
+ * that each check out one parser from the pool. The work is distributed
+ * evenly between the threads up front and threads that run out of work steal
+ * sources from the others.
+ *
+ * The results are returned in the same order as the sources. The trees
+ * remember the pool (see ParserPool) so it has to outlive them.
+ *
+ * The calling thread also parses sources and the function only returns when
+ * all sources are parsed (or skipped because of cancellation).
+ */
+std::vector<ParseResult>
+parse_many(ParserPool& pool, std::vector<Source> sources, ParseManyOptions options = {});
 
+/**
+ * @brief Result of LayeredTree::edit.
+ */
+struct LayeredEditResult {
     /**
-     * @brief Returns the raw Tree-Sitter tree.
-     *
-     * \warning
-     * Use with care. Only intended vor internal use in the wrapper types.
+     * @brief The result of editing the root tree.
+     */
+    EditResult root;
+    /**
+     * @brief The changed ranges of every layer (in the order of the layers).
      *
-     * \warning
-     * Never free or otherwise delete this pointer.
+     * Layers that were not touched by any edit are not reparsed and have no
+     * changed ranges.
      */
-    [[nodiscard]] const TSTree* raw() const;
+    std::vector<std::vector<Range>> layers;
+};
+
+/**
+ * @brief A Tree with additional trees (layers) for embedded code.
+ *
+ * Every layer is parsed from the same source code as the root tree but only
+ * from its included ranges (see Parser::set_included_ranges). E.g. Lua code
+ * in the fenced code blocks of a Markdown document.
+ *
+ * All trees are edited together with LayeredTree::edit. The ranges of the
+ * layers are moved along with the edits. Only layers whose ranges are touched
+ * by an edit are reparsed (incrementally), the other layers are only adjusted
+ * to the new positions.
+ *
+ * \note The layers keep a pointer to their parser. It has to outlive the
+ * LayeredTree. The included ranges of the parser are only set while parsing
+ * a layer.
+ */
+class LayeredTree {
+    struct Layer {
+        // not owned pointer
+        Parser* parser;
+        std::vector<Range> ranges;
+        Tree tree;
+    };
+
+    Tree root_;
+    std::vector<Layer> layers_;
 
+public:
     /**
-     * @brief The source code the tree was created from.
+     * @brief Create a LayeredTree without any layers.
      */
-    [[nodiscard]] const std::string& source() const;
+    explicit LayeredTree(Tree root);
 
     /**
-     * @brief The used parser.
+     * @brief The root tree.
      */
-    [[nodiscard]] const Parser& parser() const;
+    [[nodiscard]] const Tree& root() const;
 
     /**
-     * @brief The root node of the tree.
-     *
-     * The returned node is only valid as long as this tree is not destructed.
+     * @brief The number of layers.
      */
-    [[nodiscard]] Node root_node() const;
+    [[nodiscard]] std::size_t layer_count() const;
 
     /**
-     * @brief The language that was used to parse the syntax tree.
+     * @brief The tree of the layer with the given index.
      */
-    [[nodiscard]] Language language() const;
+    [[nodiscard]] const Tree& layer(std::size_t index) const;
 
     /**
-     * @brief Edit the syntax tree and source code and return the changed ranges.
-     *
-     * You need to specify all edits you want to apply to the syntax tree in
-     * one call. Because this method changes both the syntax tree and source
-     * code string any other [Edit](@ref Edit)s will be invalid and trying to
-     * apply them is undefined behaviour.
-     *
-     * The edits can't be duplicate or overlapping. Multiline edits are also
-     * currently not supported.
+     * @brief The ranges of the layer with the given index.
+     */
+    [[nodiscard]] const std::vector<Range>& layer_ranges(std::size_t index) const;
+
+    /**
+     * @brief Parse the given ranges of the source code with `parser` and add
+     * them as a new layer.
      *
-     * The returned result contains information about the raw string ranges
-     * that changed and it also contains the adjusted location of the edits that
-     * can e.g. be used for highlighting in an editor.
+     * Returns the index of the new layer.
      *
-     * Any previously retrieved nodes will become (silently) invalid.
+     * Throws IncludedRangesException if the ranges are empty, not sorted or
+     * overlap.
+     */
+    std::size_t add_layer(Parser& parser, std::vector<Range> ranges);
+
+    /**
+     * @brief Change the ranges of a layer and reparse it incrementally.
      *
-     * \note This takes the edits by value because they should not be used after
-     * calling this function and we need to modify the vector internally.
+     * Returns the changed ranges of the layer.
      */
-    EditResult edit(std::vector<Edit>);
+    std::vector<Range> set_layer_ranges(std::size_t index, std::vector<Range> ranges);
 
     /**
-     * @brief Print a dot graph to the given file.
+     * @brief Edit the root tree and all layers.
      *
-     * `file` has to be a null-terminated string (e.g. from a std::string).
+     * See Tree::edit. Like Tree::edit the layers are reparsed without the
+     * timeout and cancellation flag of their parsers. If an exception is
+     * thrown the root and the layers are left unchanged.
      */
-    void print_dot_graph(std::string_view file) const;
+    LayeredEditResult edit(std::vector<Edit>);
 };
 
-EditResult edit_tree(std::vector<Edit> edits, Tree& tree, TSTree* old_tree);
-
 /**
  * @brief Allows efficient walking of a Tree.
  *
  * This is more efficient than using the methods on Node because we don't create
  * a new Node after every navigation step.
- *
- * Features not included (because we currently don't use them):
- *
- * - `ts_tree_cursor_goto_first_child_for_byte`
  */
 class Cursor {
     // TSTreeCursor internally allocates heap.
@@ -994,6 +2758,18 @@ public:
      */
     bool goto_first_child();
 
+    /**
+     * @brief Move the cursor to the first child that ends after the given
+     * byte offset.
+     *
+     * Returns the index of the child or `std::nullopt` (without moving the
+     * cursor) if no child ends after the byte.
+     *
+     * Calling this repeatedly walks down to the node at a position in time
+     * proportional to the depth of the tree.
+     */
+    std::optional<std::uint32_t> goto_first_child_for_byte(std::uint32_t byte);
+
     /**
      * @brief Move the cursor to the next named sibling of the current node.
      *
@@ -1064,19 +2840,158 @@ public:
     std::vector<Node> named_children();
 };
 
+/**
+ * @brief What should happen after a visitor visited a node.
+ *
+ * Returned by the callbacks of visit_preorder and visit_postorder. Callbacks
+ * that return nothing (or anything else) always continue.
+ */
+enum class VisitAction {
+    /**
+     * @brief Continue with the children of the node (if any) and the rest of
+     * the tree.
+     */
+    Continue,
+    /**
+     * @brief Don't visit the children of the node.
+     *
+     * Only used by visit_preorder. The children were already visited in
+     * visit_postorder, so there it is the same as VisitAction::Continue.
+     */
+    SkipChildren,
+    /**
+     * @brief Stop the traversal.
+     */
+    Stop,
+};
+
+// implementation details of the templates below (not part of the API)
+namespace detail {
+// calls the visitor and treats visitors that don't return a VisitAction as continuing
+template <typename Fn> VisitAction call_visitor(Fn& fn, Node node) {
+    if constexpr (std::is_same_v<std::invoke_result_t<Fn&, Node>, VisitAction>) {
+        return fn(node);
+    } else {
+        fn(node);
+        return VisitAction::Continue;
+    }
+}
+} // namespace detail
+
+/**
+ * @brief Visits the current node of the cursor and all its descendants in
+ * pre-order (parents before their children).
+ *
+ * `fn` is called with every Node and can return a VisitAction to skip the
+ * children of a node or to stop.
+ *
+ * The traversal is iterative and only moves the given cursor, so it needs no
+ * allocations and no stack space proportional to the depth of the tree. The
+ * callback is a template parameter, so it can be inlined.
+ *
+ * Returns `false` if the visitor stopped. Then the cursor points at the node
+ * the visitor stopped at, otherwise it points at the node it started at.
+ */
+template <typename Fn> bool visit_preorder(Cursor& cursor, Fn&& fn) {
+    // depth of the current node below the start node
+    std::size_t depth = 0;
+    while (true) {
+        const VisitAction action = detail::call_visitor(fn, cursor.current_node());
+        if (action == VisitAction::Stop) {
+            return false;
+        }
+        if (action != VisitAction::SkipChildren && cursor.goto_first_child()) {
+            ++depth;
+            continue;
+        }
+
+        // the next node is the next sibling of the node or of its closest ancestor
+        while (true) {
+            if (depth == 0) {
+                return true;
+            }
+            if (cursor.goto_next_sibling()) {
+                break;
+            }
+            cursor.goto_parent();
+            --depth;
+        }
+    }
+}
+
+/**
+ * @brief Visits all nodes starting at the node in pre-order.
+ *
+ * See visit_preorder(Cursor&, Fn&&).
+ */
+template <typename Fn> bool visit_preorder(Node node, Fn&& fn) {
+    Cursor cursor(node);
+    return visit_preorder(cursor, std::forward<Fn>(fn));
+}
+
+/**
+ * @brief Visits the current node of the cursor and all its descendants in
+ * post-order (children before their parents).
+ *
+ * `fn` is called with every Node and can return VisitAction::Stop to stop.
+ *
+ * Like visit_preorder this is iterative and only moves the given cursor.
+ *
+ * Returns `false` if the visitor stopped. Then the cursor points at the node
+ * the visitor stopped at, otherwise it points at the node it started at.
+ */
+template <typename Fn> bool visit_postorder(Cursor& cursor, Fn&& fn) {
+    // depth of the current node below the start node
+    std::size_t depth = 0;
+    bool descend = true;
+    while (true) {
+        if (descend) {
+            while (cursor.goto_first_child()) {
+                ++depth;
+            }
+        }
+
+        // all children of the node were visited
+        if (detail::call_visitor(fn, cursor.current_node()) == VisitAction::Stop) {
+            return false;
+        }
+        if (depth == 0) {
+            return true;
+        }
+
+        descend = cursor.goto_next_sibling();
+        if (!descend) {
+            cursor.goto_parent();
+            --depth;
+        }
+    }
+}
+
+/**
+ * @brief Visits all nodes starting at the node in post-order.
+ *
+ * See visit_postorder(Cursor&, Fn&&).
+ */
+template <typename Fn> bool visit_postorder(Node node, Fn&& fn) {
+    Cursor cursor(node);
+    return visit_postorder(cursor, std::forward<Fn>(fn));
+}
+
 /**
  * Visits all children of the cursor and call the given function.
+ *
+ * Prefer visit_preorder, which does not call the function through a
+ * `std::function`.
  */
 void visit_children(Cursor& cursor, const std::function<void(ts::Node)>& fn);
 
 /**
  * Visits a tree using a cursor.
+ *
+ * Same as visit_preorder with the root node.
  */
 template <typename Fn> static void visit_tree(const ts::Tree& tree, Fn fn) {
-    Cursor cursor(tree);
-
-    fn(cursor.current_node());
-    visit_children(cursor, fn);
+    visit_preorder(tree.root_node(), fn);
 }
 
 /**
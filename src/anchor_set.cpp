@@ -0,0 +1,146 @@
+#include "tree_sitter/tree_sitter.hpp"
+#include <algorithm>
+
+namespace ts {
+namespace {
+// moves a location of the old source code behind the given edit to its
+// location in the new source code
+static Location _shift_location(const Location& location, const AppliedEdit& applied_edit) {
+    const Location& old_end = applied_edit.before.end;
+    const Location& new_end = applied_edit.after.end;
+
+    Point point{};
+    if (location.point.row == old_end.point.row) {
+        point = Point{
+            .row = new_end.point.row,
+            .column = new_end.point.column + (location.point.column - old_end.point.column),
+        };
+    } else {
+        point = Point{
+            .row = location.point.row + new_end.point.row - old_end.point.row,
+            .column = location.point.column,
+        };
+    }
+
+    return Location{.point = point, .byte = location.byte + new_end.byte - old_end.byte};
+}
+
+// if the location is moved by the edit. insertions at the location move it
+// (so they are not included in anchors starting there but in anchors ending
+// there) while a location at the start of a replaced range stays
+static bool _moved_by(const Location& location, const AppliedEdit& applied_edit) {
+    return applied_edit.before.start < location || applied_edit.before.end <= location;
+}
+} // namespace
+
+// class AnchorSet
+Location& AnchorSet::location(const Endpoint& endpoint) {
+    // endpoints only exist for anchors that were not removed
+    // NOLINTNEXTLINE(bugprone-unchecked-optional-access)
+    Range& range = *this->anchors_[endpoint.anchor];
+    return endpoint.is_start ? range.start : range.end;
+}
+const Location& AnchorSet::location(const Endpoint& endpoint) const {
+    // endpoints only exist for anchors that were not removed
+    // NOLINTNEXTLINE(bugprone-unchecked-optional-access)
+    const Range& range = *this->anchors_[endpoint.anchor];
+    return endpoint.is_start ? range.start : range.end;
+}
+
+void AnchorSet::insert(Endpoint endpoint) {
+    const std::uint32_t byte = this->location(endpoint).byte;
+    const auto position = std::partition_point(
+        this->endpoints_.begin(), this->endpoints_.end(),
+        [this, byte](const Endpoint& other) { return this->location(other).byte <= byte; });
+    this->endpoints_.insert(position, endpoint);
+}
+
+void AnchorSet::erase(Endpoint endpoint) {
+    const std::uint32_t byte = this->location(endpoint).byte;
+    auto position = std::partition_point(
+        this->endpoints_.begin(), this->endpoints_.end(),
+        [this, byte](const Endpoint& other) { return this->location(other).byte < byte; });
+    while (position->anchor != endpoint.anchor || position->is_start != endpoint.is_start) {
+        ++position;
+    }
+    this->endpoints_.erase(position);
+}
+
+AnchorSet::Id AnchorSet::add(Range range) {
+    const auto id = static_cast<Id>(this->anchors_.size());
+    this->anchors_.emplace_back(range);
+    this->insert(Endpoint{.anchor = id, .is_start = true});
+    this->insert(Endpoint{.anchor = id, .is_start = false});
+    ++this->size_;
+    return id;
+}
+
+void AnchorSet::remove(Id id) {
+    if (id >= this->anchors_.size() || !this->anchors_[id]) {
+        return;
+    }
+    this->erase(Endpoint{.anchor = id, .is_start = true});
+    this->erase(Endpoint{.anchor = id, .is_start = false});
+    this->anchors_[id].reset();
+    --this->size_;
+}
+
+std::optional<Range> AnchorSet::range(Id id) const {
+    if (id >= this->anchors_.size()) {
+        return std::nullopt;
+    }
+    return this->anchors_[id];
+}
+
+std::size_t AnchorSet::size() const { return this->size_; }
+
+void AnchorSet::rebase(const std::vector<AppliedEdit>& edits) {
+    if (edits.empty()) {
+        return;
+    }
+
+    // locations before the first edit don't move
+    const AppliedEdit& first_edit = edits.front();
+    auto endpoint = std::partition_point(
+        this->endpoints_.begin(), this->endpoints_.end(), [this, &first_edit](const Endpoint& e) {
+            return !_moved_by(this->location(e), first_edit);
+        });
+
+    std::size_t next_edit = 0;
+    // endpoints inside of the replaced range of the same edit (they are
+    // moved to the start or end of the replacement)
+    auto inside_begin = this->endpoints_.end();
+    const AppliedEdit* inside_edit = nullptr;
+    // moved ends could now be before moved starts of the same edit
+    const auto sort_inside = [&]() {
+        if (inside_edit != nullptr) {
+            std::stable_partition(
+                inside_begin, endpoint, [](const Endpoint& e) { return e.is_start; });
+            inside_edit = nullptr;
+        }
+    };
+
+    for (; endpoint != this->endpoints_.end(); ++endpoint) {
+        Location& location = this->location(*endpoint);
+        while (next_edit < edits.size() && _moved_by(location, edits[next_edit])) {
+            ++next_edit;
+        }
+        // there is always an edit before the location
+        const AppliedEdit& edit = edits[next_edit - 1];
+
+        if (location < edit.before.end) {
+            if (inside_edit != &edit) {
+                sort_inside();
+                inside_begin = endpoint;
+                inside_edit = &edit;
+            }
+            location = endpoint->is_start ? edit.after.start : edit.after.end;
+        } else {
+            sort_inside();
+            location = _shift_location(location, edit);
+        }
+    }
+    sort_inside();
+}
+
+} // namespace ts
@@ -0,0 +1,210 @@
+#include "tree_sitter/tree_sitter.hpp"
+#include <algorithm>
+
+namespace ts {
+namespace {
+// the diff of the lines falls back to one edit if the lines differ more than this
+// (it needs O(MAX_LINE_EDITS^2) memory)
+constexpr long MAX_LINE_EDITS = 512;
+
+// range of lines that differ between the old and new lines
+struct Hunk {
+    std::size_t old_start;
+    std::size_t old_end;
+    std::size_t new_start;
+    std::size_t new_end;
+};
+
+// splits the text into lines (including the newline)
+template <typename CharT>
+static std::vector<std::basic_string_view<CharT>> _lines(std::basic_string_view<CharT> text) {
+    std::vector<std::basic_string_view<CharT>> lines;
+    while (!text.empty()) {
+        const std::size_t end = std::min(text.find(CharT('\n')), text.size() - 1) + 1;
+        lines.push_back(text.substr(0, end));
+        text.remove_prefix(end);
+    }
+    return lines;
+}
+
+// offsets (in characters) of the start of the lines (and the end of the last line)
+template <typename CharT>
+static std::vector<std::uint32_t>
+_line_offsets(const std::vector<std::basic_string_view<CharT>>& lines) {
+    std::vector<std::uint32_t> offsets{0};
+    offsets.reserve(lines.size() + 1);
+    for (const auto& line : lines) {
+        offsets.push_back(offsets.back() + line.size());
+    }
+    return offsets;
+}
+
+template <typename CharT>
+static std::size_t
+_common_prefix(std::basic_string_view<CharT> a, std::basic_string_view<CharT> b) {
+    const std::size_t size = std::min(a.size(), b.size());
+    return std::mismatch(a.begin(), a.begin() + size, b.begin()).first - a.begin();
+}
+
+template <typename CharT>
+static std::size_t
+_common_suffix(std::basic_string_view<CharT> a, std::basic_string_view<CharT> b) {
+    const std::size_t size = std::min(a.size(), b.size());
+    return std::mismatch(a.rbegin(), a.rbegin() + size, b.rbegin()).first - a.rbegin();
+}
+
+// Myers' diff (see "An O(ND) Difference Algorithm and Its Variations")
+// returns nothing if the lines differ in more than max_edits lines
+template <typename CharT>
+static std::optional<std::vector<Hunk>> _diff_lines(
+    const std::vector<std::basic_string_view<CharT>>& old_lines,
+    const std::vector<std::basic_string_view<CharT>>& new_lines, long max_edits) {
+    const auto n = static_cast<long>(old_lines.size());
+    const auto m = static_cast<long>(new_lines.size());
+    const long max = std::min(n + m, max_edits);
+
+    // v[offset + k] is the furthest x on diagonal k (y = x - k)
+    const long offset = max + 1;
+    std::vector<long> v(2 * offset + 1, 0);
+    // the values of v in [-d, d] before step d (used to backtrack)
+    std::vector<std::vector<long>> trace;
+
+    auto is_down = [&](long d, long k, const auto& x_at) {
+        return k == -d || (k != d && x_at(k - 1) < x_at(k + 1));
+    };
+
+    for (long d = 0; d <= max; ++d) {
+        trace.emplace_back(v.begin() + offset - d, v.begin() + offset + d + 1);
+
+        for (long k = -d; k <= d; k += 2) {
+            auto x_at = [&](long diagonal) { return v[offset + diagonal]; };
+            long x = is_down(d, k, x_at) ? x_at(k + 1) : x_at(k - 1) + 1;
+            long y = x - k;
+            while (x < n && y < m && old_lines[x] == new_lines[y]) {
+                ++x;
+                ++y;
+            }
+            v[offset + k] = x;
+
+            if (x < n || y < m) {
+                continue;
+            }
+
+            // backtrack the single line edits and merge them into hunks
+            std::vector<Hunk> hunks;
+            for (long step = d; step > 0; --step) {
+                const std::vector<long>& prev = trace[step];
+                auto prev_x_at = [&](long diagonal) { return prev[diagonal + step]; };
+
+                const long prev_k = is_down(step, k, prev_x_at) ? k + 1 : k - 1;
+                const long prev_x = prev_x_at(prev_k);
+                const long prev_y = prev_x - prev_k;
+                // position after the line edit (before the equal lines)
+                const long edit_x = is_down(step, k, prev_x_at) ? prev_x : prev_x + 1;
+                const long edit_y = edit_x - k;
+
+                if (!hunks.empty() && hunks.back().old_start == static_cast<std::size_t>(edit_x) &&
+                    hunks.back().new_start == static_cast<std::size_t>(edit_y)) {
+                    hunks.back().old_start = prev_x;
+                    hunks.back().new_start = prev_y;
+                } else {
+                    hunks.push_back(Hunk{
+                        .old_start = static_cast<std::size_t>(prev_x),
+                        .old_end = static_cast<std::size_t>(edit_x),
+                        .new_start = static_cast<std::size_t>(prev_y),
+                        .new_end = static_cast<std::size_t>(edit_y),
+                    });
+                }
+
+                k = prev_k;
+            }
+            std::reverse(hunks.begin(), hunks.end());
+            return hunks;
+        }
+    }
+
+    return std::nullopt;
+}
+
+// the edit replacing the characters [start, end) (offsets are converted to bytes)
+static Edit _edit(std::size_t start, std::size_t end, std::string_view replacement) {
+    return Edit::from_bytes(start, end, std::string(replacement));
+}
+static Edit _edit(std::size_t start, std::size_t end, std::u16string_view replacement) {
+    return Edit::from_bytes(start * sizeof(char16_t), end * sizeof(char16_t), replacement);
+}
+
+template <typename CharT>
+static std::vector<Edit>
+_diff_edits(std::basic_string_view<CharT> old_source, std::basic_string_view<CharT> new_source) {
+    using string_view = std::basic_string_view<CharT>;
+
+    // only the middle part that is not shared by both needs to be diffed.
+    // it has to start and end at the start of a line so the lines of the old
+    // and new source code can be compared
+    std::size_t prefix = _common_prefix(old_source, new_source);
+    prefix = old_source.substr(0, prefix).rfind(CharT('\n')) + 1;
+
+    std::size_t suffix = _common_suffix(old_source.substr(prefix), new_source.substr(prefix));
+    const std::size_t suffix_start = old_source.size() - suffix;
+    if (suffix_start > 0 && old_source[suffix_start - 1] != CharT('\n')) {
+        const std::size_t line_end = old_source.find(CharT('\n'), suffix_start);
+        suffix = line_end == string_view::npos ? 0 : old_source.size() - line_end - 1;
+    }
+
+    const string_view old_middle =
+        old_source.substr(prefix, old_source.size() - prefix - suffix);
+    const string_view new_middle =
+        new_source.substr(prefix, new_source.size() - prefix - suffix);
+
+    if (old_middle.empty() && new_middle.empty()) {
+        return {};
+    }
+
+    const std::vector<string_view> old_lines = _lines(old_middle);
+    const std::vector<string_view> new_lines = _lines(new_middle);
+
+    const std::optional<std::vector<Hunk>> hunks =
+        _diff_lines(old_lines, new_lines, MAX_LINE_EDITS);
+    if (!hunks) {
+        return {_edit(prefix, prefix + old_middle.size(), new_middle)};
+    }
+
+    const std::vector<std::uint32_t> old_offsets = _line_offsets(old_lines);
+    const std::vector<std::uint32_t> new_offsets = _line_offsets(new_lines);
+
+    std::vector<Edit> edits;
+    edits.reserve(hunks->size());
+    for (const Hunk& hunk : *hunks) {
+        const std::uint32_t old_start = old_offsets[hunk.old_start];
+        const std::uint32_t new_start = new_offsets[hunk.new_start];
+        string_view old_text =
+            old_middle.substr(old_start, old_offsets[hunk.old_end] - old_start);
+        string_view new_text =
+            new_middle.substr(new_start, new_offsets[hunk.new_end] - new_start);
+
+        // only replace the characters that changed inside of the lines
+        const std::size_t hunk_prefix = _common_prefix(old_text, new_text);
+        old_text.remove_prefix(hunk_prefix);
+        new_text.remove_prefix(hunk_prefix);
+        const std::size_t hunk_suffix = _common_suffix(old_text, new_text);
+        old_text.remove_suffix(hunk_suffix);
+        new_text.remove_suffix(hunk_suffix);
+
+        const std::uint32_t start = prefix + old_start + hunk_prefix;
+        edits.push_back(_edit(start, start + old_text.size(), new_text));
+    }
+
+    return edits;
+}
+} // namespace
+
+std::vector<Edit> diff_edits(std::string_view old_source, std::string_view new_source) {
+    return _diff_edits(old_source, new_source);
+}
+
+std::vector<Edit> diff_edits(std::u16string_view old_source, std::u16string_view new_source) {
+    return _diff_edits(old_source, new_source);
+}
+
+} // namespace ts
@@ -1,70 +1,68 @@
 #include "tree_sitter/tree_sitter.hpp"
+#include "edit_helper.hpp"
 #include <algorithm>
 
 namespace ts {
 // helper functions for Tree::edit
 namespace {
-// helper function to apply one edit to the tree and source code
-static AppliedEdit _apply_edit(const Edit& edit, TSTree* tree, std::string& source) {
-    const long old_size = edit.range.end.byte - edit.range.start.byte;
-
-    const std::string old_source = source.substr(edit.range.start.byte, old_size);
+// the location after inserting `text` (encoded with `encoding`) at `start`
+static Location _advance(const Location& start, std::string_view text, Encoding encoding) {
+    const auto size = static_cast<std::uint32_t>(text.size());
+    std::uint32_t rows = 0;
+    std::uint32_t last_line_start = 0;
+    for_each_line_start(text, encoding, [&](std::size_t line_start) {
+        ++rows;
+        last_line_start = static_cast<std::uint32_t>(line_start);
+    });
 
-    source.replace(edit.range.start.byte, old_size, edit.replacement);
+    if (rows == 0) {
+        return Location{
+            .point = {.row = start.point.row, .column = start.point.column + size},
+            .byte = start.byte + size,
+        };
+    }
 
-    const long end_byte_diff = static_cast<long>(edit.replacement.size()) - old_size;
+    return Location{
+        .point = {.row = start.point.row + rows, .column = size - last_line_start},
+        .byte = start.byte + size,
+    };
+}
 
+// helper function to apply one edit to the tree
+// (the source code is edited separately, see _apply_all_edits)
+// the replacement is moved into the result because the edit is not used afterwards
+static AppliedEdit _apply_edit(Edit& edit, TSTree* tree, Encoding encoding) {
     const Range before = edit.range;
-    const auto column = static_cast<std::uint32_t>(before.end.point.column + end_byte_diff);
-    const auto byte = static_cast<std::uint32_t>(before.end.byte + end_byte_diff);
     const Range after{
         .start = edit.range.start,
-        .end = {
-            .point = {.row = edit.range.end.point.row, .column = column},
-            .byte = byte,
-        }};
+        .end = _advance(edit.range.start, edit.replacement, encoding),
+    };
 
     const TSInputEdit input_edit{
         .start_byte = before.start.byte,
         .old_end_byte = before.end.byte,
         .new_end_byte = after.end.byte,
-        .start_point =
-            TSPoint{
-                .row = before.start.point.row,
-                .column = before.start.point.column,
-            },
-        .old_end_point =
-            TSPoint{
-                .row = before.end.point.row,
-                .column = before.end.point.column,
-            },
-        .new_end_point =
-            TSPoint{
-                .row = after.end.point.row,
-                .column = after.end.point.column,
-            },
+        .start_point = to_ts_point(before.start.point),
+        .old_end_point = to_ts_point(before.end.point),
+        .new_end_point = to_ts_point(after.end.point),
     };
 
-    ts_tree_edit(tree, &input_edit);
+    // the tree is null if it is not reused for reparsing
+    if (tree != nullptr) {
+        ts_tree_edit(tree, &input_edit);
+    }
 
     return AppliedEdit{
         .before = before,
         .after = after,
-        .old_source = old_source,
-        .replacement = edit.replacement,
-    };
-}
-
-static inline Point _point(const TSPoint& point) {
-    return Point{
-        .row = point.row,
-        .column = point.column,
+        .old_source = {},
+        .replacement = std::move(edit.replacement),
     };
 }
 
 static inline Location _location(const TSPoint& point, const std::uint32_t byte) {
     return Location{
-        .point = _point(point),
+        .point = from_ts_point(point),
         .byte = byte,
     };
 }
@@ -76,7 +74,9 @@ static inline Range _range(const TSRange& range) {
     };
 }
 
-static std::vector<Range> _get_changed_ranges(const TSTree* old_tree, const TSTree* new_tree) {
+} // namespace
+
+std::vector<Range> get_changed_ranges(const TSTree* old_tree, const TSTree* new_tree) {
     // this will always be set by ts_tree_get_changed_ranges
     // NOLINTNEXTLINE(cppcoreguidelines-init-variables)
     std::uint32_t length;
@@ -101,121 +101,315 @@ static std::vector<Range> _get_changed_ranges(const TSTree* old_tree, const TSTr
     return changed_ranges;
 }
 
-static inline void _forbid_zero_sized_edit(const Edit& edit) {
-    if (edit.range.start == edit.range.end) {
-        throw ZeroSizedEditException();
-    }
-}
-static inline void _forbid_multiline_edit(const Edit& edit) {
-    if (edit.range.start.point.row != edit.range.end.point.row ||
-        edit.replacement.find('\n') != std::string::npos) {
-        throw MultilineEditException();
-    }
-}
+namespace {
 
 static inline void _check_edits(const std::vector<Edit>& edits) {
-    // NOTE: assumes that the ranges are already sorted by edit.range.start.byte
-
-    for (int i = 0; i < edits.size(); ++i) {
-        const auto& edit1 = edits[i];
-
-        _forbid_zero_sized_edit(edit1);
-        _forbid_multiline_edit(edit1);
+    // NOTE: assumes that the ranges are already sorted (see _prepare_edits)
 
+    for (std::size_t i = 1; i < edits.size(); ++i) {
         // forbid overlapping edits
-        for (int j = 0; j < edits.size(); ++j) {
-            if (i == j) {
-                continue;
-            }
-
-            const auto& edit2 = edits[j];
-
-            if (edit1.range.overlaps(edit2.range)) {
-                throw OverlappingEditException();
-            }
+        // (because the edits are sorted and the previous edits don't overlap
+        // it is enough to compare with the previous edit which has the
+        // greatest end)
+        // NOTE: insertions (empty ranges) only overlap edits that contain
+        // their location
+        if (edits[i - 1].range.overlaps(edits[i].range)) {
+            throw OverlappingEditException();
         }
     }
 }
 
+// how the locations after the last applied edit moved
 struct Adjustment {
-    Point last_point;
-    int last_width_change;
-    int cumulative_byte_change;
+    // row where the last edit ended (before it was applied)
+    std::uint32_t last_row;
+    // column change in last_row (after the end of the last edit)
+    long last_column_change;
+    long cumulative_row_change;
+    long cumulative_byte_change;
 };
-static inline void _adjust_edit(Edit& edit, const Adjustment& adjustment) {
-    // if the last edit was in the current line we need to adjust the
-    // location of the next edit
-    if (adjustment.last_width_change != 0 &&
-        adjustment.last_point.row == edit.range.start.point.row) {
-        edit.range.start.point.column += adjustment.last_width_change;
-        edit.range.end.point.column += adjustment.last_width_change;
+static inline void _adjust_location(Location& location, const Adjustment& adjustment) {
+    // if the last edit ended in the current line we need to adjust the column
+    if (location.point.row == adjustment.last_row) {
+        location.point.column += adjustment.last_column_change;
     }
 
-    edit.range.start.byte += adjustment.cumulative_byte_change;
-    edit.range.end.byte += adjustment.cumulative_byte_change;
+    location.point.row += adjustment.cumulative_row_change;
+    location.byte += adjustment.cumulative_byte_change;
+}
+static inline void _adjust_edit(Edit& edit, const Adjustment& adjustment) {
+    _adjust_location(edit.range.start, adjustment);
+    _adjust_location(edit.range.end, adjustment);
+}
+static inline void _update_adjustment(Adjustment& adjustment, const AppliedEdit& applied_edit) {
+    // before is the range without adjustments, after is fully adjusted
+    const Location& before_end = applied_edit.before.end;
+    const Location& after_end = applied_edit.after.end;
+
+    adjustment.last_row = before_end.point.row;
+    adjustment.last_column_change =
+        static_cast<long>(after_end.point.column) - static_cast<long>(before_end.point.column);
+    adjustment.cumulative_row_change =
+        static_cast<long>(after_end.point.row) - static_cast<long>(before_end.point.row);
+    adjustment.cumulative_byte_change =
+        static_cast<long>(after_end.byte) - static_cast<long>(before_end.byte);
 }
-static inline void _update_adjustment(
-    Adjustment& adjustment, const AppliedEdit& applied_edit, const Point last_point) {
-    const int before_width =
-        applied_edit.before.end.point.column - applied_edit.before.start.point.column;
-    const int after_width =
-        applied_edit.after.end.point.column - applied_edit.after.start.point.column;
-    adjustment.last_width_change = after_width - before_width;
 
-    const int byte_change = applied_edit.after.end.byte - applied_edit.before.end.byte;
-    adjustment.cumulative_byte_change += byte_change;
-    adjustment.last_point = last_point;
+static inline std::size_t
+_edited_size(const std::vector<Edit>& edits, const std::size_t old_size) {
+    std::size_t size = old_size;
+    for (const auto& edit : edits) {
+        size += edit.replacement.size();
+        size -= edit.range.end.byte - edit.range.start.byte;
+    }
+    return size;
 }
 
-static inline std::vector<AppliedEdit>
-_apply_all_edits(std::vector<Edit>& edits, std::string& new_source, TSTree* old_tree) {
+// applies all (sorted) edits to the tree and builds the edited source code in
+// one pass over the old source code
+// (new_source is nullptr if the tree reads its source code with a Reader)
+static inline std::vector<AppliedEdit> _apply_all_edits(
+    std::vector<Edit>& edits, std::string_view old_source, std::string* new_source,
+    TSTree* old_tree, Encoding encoding, const EditOptions& options) {
     std::vector<AppliedEdit> applied_edits;
     applied_edits.reserve(edits.size());
 
+    if (new_source != nullptr) {
+        new_source->reserve(_edited_size(edits, old_source.size()));
+    }
+
     Adjustment adjustment{};
+    // everything in the old source code before this was already copied
+    std::size_t copied_until = 0;
 
     for (auto& edit : edits) {
         const Range range_before_adjustments = edit.range;
         _adjust_edit(edit, adjustment);
 
-        AppliedEdit applied_edit = _apply_edit(edit, old_tree, new_source);
+        AppliedEdit applied_edit = _apply_edit(edit, old_tree, encoding);
         applied_edit.before = range_before_adjustments;
-        applied_edits.push_back(applied_edit);
 
-        _update_adjustment(adjustment, applied_edit, edit.range.end.point);
+        if (new_source != nullptr) {
+            const std::uint32_t start = range_before_adjustments.start.byte;
+            const std::uint32_t end = range_before_adjustments.end.byte;
+
+            new_source->append(old_source.substr(copied_until, start - copied_until));
+            new_source->append(applied_edit.replacement);
+            if (options.copy_old_source) {
+                applied_edit.old_source = old_source.substr(start, end - start);
+            }
+            copied_until = end;
+        }
+
+        _update_adjustment(adjustment, applied_edit);
+        applied_edits.push_back(std::move(applied_edit));
+    }
+
+    if (new_source != nullptr) {
+        new_source->append(old_source.substr(copied_until));
     }
 
     return applied_edits;
 }
-} // namespace
 
-EditResult edit_tree(std::vector<Edit> edits, Tree& tree, TSTree* old_tree) {
-    std::string new_source = tree.source();
+// the bytes replaced and inserted by the edits (see ReparsePolicy)
+static inline std::size_t _touched_bytes(const std::vector<Edit>& edits) {
+    std::size_t touched = 0;
+    for (const auto& edit : edits) {
+        touched += edit.range.end.byte - edit.range.start.byte + edit.replacement.size();
+    }
+    return touched;
+}
+
+// if the edits are reparsed from scratch (see EditOptions::reparse_policy)
+static inline bool _full_reparse(
+    const EditOptions& options, std::size_t edit_count, std::size_t touched_bytes,
+    std::size_t source_size) {
+    const bool full = options.reparse_policy.has_value() &&
+                      options.reparse_policy->full_reparse(edit_count, touched_bytes, source_size);
+
+    if (ReparseStatistics* statistics = options.reparse_statistics) {
+        if (full) {
+            ++statistics->full_reparses;
+        } else {
+            ++statistics->incremental_reparses;
+        }
+    }
+    return full;
+}
 
+// old_tree is null if the new tree was reparsed from scratch
+static inline std::vector<Range> _changed_ranges(const TSTree* old_tree, const Tree& new_tree) {
+    if (old_tree == nullptr) {
+        // everything could have changed
+        return {Range{
+            .start = {.point = {.row = 0, .column = 0}, .byte = 0},
+            .end = new_tree.root_node().end(),
+        }};
+    }
+    return get_changed_ranges(old_tree, new_tree.raw());
+}
+
+// old_tree is null if the edits are reparsed from scratch
+static inline std::vector<AppliedEdit> _apply_piece_table_edits(
+    std::vector<Edit>& edits, TSTree* old_tree, PieceTable& source, const EditOptions& options) {
+    // the piece table is edited after applying the edits to the tree
+    std::vector<AppliedEdit> applied_edits =
+        _apply_all_edits(edits, {}, nullptr, old_tree, source.encoding(), options);
+    if (options.copy_old_source) {
+        for (auto& applied_edit : applied_edits) {
+            applied_edit.old_source =
+                source.text(applied_edit.before.start.byte, applied_edit.before.end.byte);
+        }
+    }
+
+    source = source.edited(applied_edits);
+
+    return applied_edits;
+}
+
+// old_tree is null if the source code is reparsed from scratch
+static inline EditResult _reparse_piece_table(
+    Tree& tree, TSTree* old_tree, const Parser& parser, PieceTable new_source,
+    std::vector<AppliedEdit> applied_edits) {
+    // reparse the source code
+    const UninterruptedParse uninterrupted{parser};
+    Tree new_tree = parser.parse_piece_table(old_tree, std::move(new_source));
+
+    std::vector<Range> changed_ranges = _changed_ranges(old_tree, new_tree);
+
+    // update this tree
+    swap(tree, new_tree);
+
+    return EditResult{
+        .changed_ranges = std::move(changed_ranges),
+        .applied_edits = std::move(applied_edits),
+    };
+}
+
+static inline void _prepare_edits(std::vector<Edit>& edits) {
     // sorts the edits from the earliest in the source code to the latest in the source code.
     // this is done so the locations for edits in the same line can be adjusted
-    // so we can return the ranges of the edit before and after
-    std::sort(edits.begin(), edits.end(), [](const Edit& edit1, const Edit& edit2) {
-        return edit1.range.start.byte <= edit2.range.start.byte;
+    // so we can return the ranges of the edit before and after.
+    // insertions are sorted before other edits at the same location and
+    // multiple insertions at the same location keep their order
+    std::stable_sort(edits.begin(), edits.end(), [](const Edit& edit1, const Edit& edit2) {
+        if (edit1.range.start.byte != edit2.range.start.byte) {
+            return edit1.range.start.byte < edit2.range.start.byte;
+        }
+        return edit1.range.end.byte < edit2.range.end.byte;
     });
 
     // NOTE: this throws exceptions if there is something wrong with the edits
     _check_edits(edits);
+}
+} // namespace
+
+EditResult edit_tree(
+    std::vector<Edit> edits, Tree& tree, TSTree* old_tree, const Parser& parser,
+    EditOptions options) {
+    _prepare_edits(edits);
+
+    // the old tree is not edited if it is not reused
+    const std::size_t old_size = tree.source_buffer().size();
+    if (_full_reparse(options, edits.size(), _touched_bytes(edits), old_size)) {
+        old_tree = nullptr;
+    }
+
+    // the raw bytes of the source code (UTF-16 trees are edited in bytes too)
+    const Source& old_source = tree.source_buffer();
+    std::string new_source;
+    std::vector<AppliedEdit> applied_edits = _apply_all_edits(
+        edits, old_source.view(), &new_source, old_tree, old_source.encoding(), options);
+
+    // reparse the source code
+    const UninterruptedParse uninterrupted{parser};
+    Tree new_tree =
+        parser.parse_source(old_tree, Source(std::move(new_source), old_source.encoding()));
+
+    std::vector<Range> changed_ranges = _changed_ranges(old_tree, new_tree);
 
-    std::vector<AppliedEdit> applied_edits = _apply_all_edits(edits, new_source, old_tree);
+    // update this tree
+    swap(tree, new_tree);
+
+    return EditResult{
+        .changed_ranges = std::move(changed_ranges),
+        .applied_edits = std::move(applied_edits),
+    };
+}
+
+EditResult edit_tree(
+    std::vector<Edit> edits, Tree& tree, TSTree* old_tree, const Parser& parser,
+    Reader new_source, EditOptions options) {
+    _prepare_edits(edits);
+
+    // the size of the old source code is only known from the old tree
+    const std::size_t old_size = ts_node_end_byte(ts_tree_root_node(old_tree));
+    if (_full_reparse(options, edits.size(), _touched_bytes(edits), old_size)) {
+        old_tree = nullptr;
+    }
+
+    // the source code is already edited by the caller
+    std::vector<AppliedEdit> applied_edits =
+        _apply_all_edits(edits, {}, nullptr, old_tree, Encoding::UTF8, options);
 
     // reparse the source code
-    Tree new_tree = tree.parser().parse_string(old_tree, std::move(new_source));
+    const UninterruptedParse uninterrupted{parser};
+    Tree new_tree = parser.parse(old_tree, std::move(new_source));
 
-    std::vector<Range> changed_ranges = _get_changed_ranges(old_tree, new_tree.raw());
+    std::vector<Range> changed_ranges = _changed_ranges(old_tree, new_tree);
 
     // update this tree
     swap(tree, new_tree);
 
     return EditResult{
-        .changed_ranges = changed_ranges,
-        .applied_edits = applied_edits,
+        .changed_ranges = std::move(changed_ranges),
+        .applied_edits = std::move(applied_edits),
     };
 }
 
+EditResult edit_tree(
+    std::vector<Edit> edits, Tree& tree, TSTree* old_tree, const Parser& parser,
+    const PieceTable& old_source, EditOptions options) {
+    _prepare_edits(edits);
+
+    if (_full_reparse(options, edits.size(), _touched_bytes(edits), old_source.size())) {
+        old_tree = nullptr;
+    }
+
+    PieceTable new_source = old_source;
+    std::vector<AppliedEdit> applied_edits =
+        _apply_piece_table_edits(edits, old_tree, new_source, options);
+
+    return _reparse_piece_table(
+        tree, old_tree, parser, std::move(new_source), std::move(applied_edits));
+}
+
+std::vector<AppliedEdit> apply_edits(
+    std::vector<Edit> edits, TSTree* tree, PieceTable& source, const EditOptions& options) {
+    _prepare_edits(edits);
+
+    return _apply_piece_table_edits(edits, tree, source, options);
+}
+
+EditResult reparse_tree(
+    Tree& tree, TSTree* old_tree, const Parser& parser, PieceTable new_source,
+    std::vector<AppliedEdit> applied_edits, const EditOptions& options) {
+    std::size_t touched_bytes = 0;
+    std::size_t old_size = new_source.size();
+    for (const auto& applied_edit : applied_edits) {
+        const std::size_t replaced = applied_edit.before.end.byte - applied_edit.before.start.byte;
+        touched_bytes += replaced + applied_edit.replacement.size();
+        old_size += replaced - applied_edit.replacement.size();
+    }
+
+    // the old tree is already edited but it can still be ignored
+    if (_full_reparse(options, applied_edits.size(), touched_bytes, old_size)) {
+        old_tree = nullptr;
+    }
+
+    return _reparse_piece_table(
+        tree, old_tree, parser, std::move(new_source), std::move(applied_edits));
+}
+
 } // namespace ts
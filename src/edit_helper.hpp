@@ -0,0 +1,70 @@
+#ifndef TREE_SITTER_EDIT_HELPER_HPP
+#define TREE_SITTER_EDIT_HELPER_HPP
+
+#include "tree_sitter/tree_sitter.hpp"
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// internal helpers shared by the implementations of Tree::edit, LayeredTree::edit, Node and
+// Parser
+namespace ts {
+
+// the Tree-Sitter point for a Point
+inline TSPoint to_ts_point(const Point& point) {
+    return TSPoint{.row = point.row, .column = point.column};
+}
+
+// the Point for a Tree-Sitter point
+inline Point from_ts_point(const TSPoint& point) {
+    return Point{.row = point.row, .column = point.column};
+}
+
+// calls fn with the offset after every newline in `text` (which is encoded
+// with `encoding`, so for UTF-16 only whole code units are compared)
+template <typename Fn> void for_each_line_start(std::string_view text, Encoding encoding, Fn fn) {
+    if (encoding == Encoding::UTF16) {
+        for (std::size_t pos = 0; pos + sizeof(char16_t) <= text.size(); pos += sizeof(char16_t)) {
+            char16_t unit = 0;
+            std::memcpy(&unit, text.data() + pos, sizeof(char16_t));
+            if (unit == u'\n') {
+                fn(pos + sizeof(char16_t));
+            }
+        }
+        return;
+    }
+
+    for (std::size_t pos = text.find('\n'); pos != std::string_view::npos;
+         pos = text.find('\n', pos + 1)) {
+        fn(pos + 1);
+    }
+}
+
+// disables the timeout and cancellation flag of the parser while it exists
+// because a halted reparse would leave the edited tree in an invalid state
+class UninterruptedParse {
+    TSParser* parser;
+    const std::uint64_t timeout;
+    const std::size_t* const cancellation_flag;
+
+public:
+    explicit UninterruptedParse(const Parser& parser)
+        : parser(parser.raw()), timeout(ts_parser_timeout_micros(this->parser)),
+          cancellation_flag(ts_parser_cancellation_flag(this->parser)) {
+        ts_parser_set_timeout_micros(this->parser, 0);
+        ts_parser_set_cancellation_flag(this->parser, nullptr);
+    }
+    ~UninterruptedParse() {
+        ts_parser_set_timeout_micros(this->parser, this->timeout);
+        ts_parser_set_cancellation_flag(this->parser, this->cancellation_flag);
+    }
+
+    UninterruptedParse(const UninterruptedParse&) = delete;
+    UninterruptedParse& operator=(const UninterruptedParse&) = delete;
+    UninterruptedParse(UninterruptedParse&&) = delete;
+    UninterruptedParse& operator=(UninterruptedParse&&) = delete;
+};
+
+} // namespace ts
+
+#endif
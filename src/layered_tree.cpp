@@ -0,0 +1,193 @@
+#include "tree_sitter/tree_sitter.hpp"
+#include "edit_helper.hpp"
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace ts {
+// helper functions for LayeredTree
+namespace {
+// sets the included ranges of the parser while it exists
+class IncludedRanges {
+    Parser& parser;
+
+public:
+    IncludedRanges(Parser& parser, const std::vector<Range>& ranges) : parser(parser) {
+        this->parser.set_included_ranges(ranges);
+    }
+    ~IncludedRanges() { this->parser.set_included_ranges({}); }
+
+    IncludedRanges(const IncludedRanges&) = delete;
+    IncludedRanges& operator=(const IncludedRanges&) = delete;
+    IncludedRanges(IncludedRanges&&) = delete;
+    IncludedRanges& operator=(IncludedRanges&&) = delete;
+};
+
+static Tree _parse_layer(
+    Parser& parser, const std::vector<Range>& ranges, const TSTree* old_tree,
+    const Source& source) {
+    if (ranges.empty()) {
+        throw IncludedRangesException();
+    }
+
+    const IncludedRanges included_ranges{parser, ranges};
+    return parser.parse_source(old_tree, source);
+}
+
+// the TSInputEdit that was used to apply the edit to the root tree
+//
+// `before` is the range in the original source code and `after` is the range
+// after applying all previous edits, so the old end has to be computed from
+// the start of `after` and the size of `before`.
+static TSInputEdit _input_edit(const AppliedEdit& applied_edit) {
+    const Range& before = applied_edit.before;
+    const Range& after = applied_edit.after;
+
+    Point old_end_point{};
+    if (before.start.point.row == before.end.point.row) {
+        old_end_point = Point{
+            .row = after.start.point.row,
+            .column =
+                after.start.point.column + (before.end.point.column - before.start.point.column),
+        };
+    } else {
+        old_end_point = Point{
+            .row = after.start.point.row + (before.end.point.row - before.start.point.row),
+            .column = before.end.point.column,
+        };
+    }
+
+    return TSInputEdit{
+        .start_byte = after.start.byte,
+        .old_end_byte = after.start.byte + (before.end.byte - before.start.byte),
+        .new_end_byte = after.end.byte,
+        .start_point = to_ts_point(after.start.point),
+        .old_end_point = to_ts_point(old_end_point),
+        .new_end_point = to_ts_point(after.end.point),
+    };
+}
+
+// moves the ranges along with the (sorted) applied edits (see AnchorSet)
+static std::vector<Range>
+_rebase_ranges(const std::vector<Range>& ranges, const std::vector<AppliedEdit>& applied_edits) {
+    AnchorSet anchors;
+    for (const Range& range : ranges) {
+        anchors.add(range);
+    }
+    anchors.rebase(applied_edits);
+
+    std::vector<Range> new_ranges;
+    new_ranges.reserve(ranges.size());
+    for (AnchorSet::Id id = 0; id < ranges.size(); ++id) {
+        // NOLINTNEXTLINE(bugprone-unchecked-optional-access)
+        new_ranges.push_back(*anchors.range(id));
+    }
+    return new_ranges;
+}
+
+// checks if any of the edits overlaps or touches any of the ranges
+static bool
+_is_touched(const std::vector<Range>& ranges, const std::vector<AppliedEdit>& applied_edits) {
+    std::size_t range_index = 0;
+    for (const AppliedEdit& applied_edit : applied_edits) {
+        // skip the ranges that end before the edit
+        while (range_index < ranges.size() &&
+               ranges[range_index].end < applied_edit.before.start) {
+            ++range_index;
+        }
+        if (range_index == ranges.size()) {
+            return false;
+        }
+        if (ranges[range_index].start <= applied_edit.before.end) {
+            return true;
+        }
+    }
+    return false;
+}
+} // namespace
+
+// class LayeredTree
+LayeredTree::LayeredTree(Tree root) : root_(std::move(root)) {
+    if (this->root_.has_reader()) {
+        throw MissingSourceException();
+    }
+}
+
+const Tree& LayeredTree::root() const { return this->root_; }
+std::size_t LayeredTree::layer_count() const { return this->layers_.size(); }
+const Tree& LayeredTree::layer(std::size_t index) const { return this->layers_.at(index).tree; }
+const std::vector<Range>& LayeredTree::layer_ranges(std::size_t index) const {
+    return this->layers_.at(index).ranges;
+}
+
+std::size_t LayeredTree::add_layer(Parser& parser, std::vector<Range> ranges) {
+    Tree tree = _parse_layer(parser, ranges, nullptr, this->root_.source_buffer());
+    this->layers_.push_back(Layer{
+        .parser = &parser,
+        .ranges = std::move(ranges),
+        .tree = std::move(tree),
+    });
+    return this->layers_.size() - 1;
+}
+
+std::vector<Range> LayeredTree::set_layer_ranges(std::size_t index, std::vector<Range> ranges) {
+    Layer& layer = this->layers_.at(index);
+
+    Tree new_tree =
+        _parse_layer(*layer.parser, ranges, layer.tree.raw(), this->root_.source_buffer());
+    std::vector<Range> changed_ranges = get_changed_ranges(layer.tree.raw(), new_tree.raw());
+
+    layer.tree = std::move(new_tree);
+    layer.ranges = std::move(ranges);
+    return changed_ranges;
+}
+
+LayeredEditResult LayeredTree::edit(std::vector<Edit> edits) {
+    // the root and the layers are only replaced after all of them were reparsed
+    // (so an exception leaves the LayeredTree unchanged)
+    Tree new_root = this->root_;
+    LayeredEditResult result{.root = new_root.edit(std::move(edits)), .layers = {}};
+    const std::vector<AppliedEdit>& applied_edits = result.root.applied_edits;
+
+    std::vector<Layer> new_layers;
+    new_layers.reserve(this->layers_.size());
+    result.layers.reserve(this->layers_.size());
+    for (const Layer& layer : this->layers_) {
+        std::vector<Range> new_ranges = _rebase_ranges(layer.ranges, applied_edits);
+
+        // move the nodes of the layer to their new positions
+        std::unique_ptr<TSTree, void (*)(TSTree*)> edited_tree{
+            ts_tree_copy(layer.tree.raw()), ts_tree_delete};
+        for (const AppliedEdit& applied_edit : applied_edits) {
+            const TSInputEdit input_edit = _input_edit(applied_edit);
+            ts_tree_edit(edited_tree.get(), &input_edit);
+        }
+
+        if (_is_touched(layer.ranges, applied_edits)) {
+            // like Tree::edit the reparse ignores the timeout and cancellation flag
+            const UninterruptedParse uninterrupted{*layer.parser};
+            Tree new_tree = _parse_layer(
+                *layer.parser, new_ranges, edited_tree.get(), new_root.source_buffer());
+            result.layers.push_back(get_changed_ranges(edited_tree.get(), new_tree.raw()));
+            new_layers.push_back(Layer{
+                .parser = layer.parser,
+                .ranges = std::move(new_ranges),
+                .tree = std::move(new_tree),
+            });
+        } else {
+            // the text of the layer did not change so there is nothing to reparse
+            result.layers.emplace_back();
+            new_layers.push_back(Layer{
+                .parser = layer.parser,
+                .ranges = std::move(new_ranges),
+                .tree = Tree(edited_tree.release(), new_root.source_buffer(), *layer.parser),
+            });
+        }
+    }
+
+    this->root_ = std::move(new_root);
+    this->layers_ = std::move(new_layers);
+    return result;
+}
+
+} // namespace ts
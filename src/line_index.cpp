@@ -0,0 +1,87 @@
+#include "tree_sitter/tree_sitter.hpp"
+#include "edit_helper.hpp"
+#include <algorithm>
+
+namespace ts {
+namespace {
+// appends the starts of the lines that begin in `chunk` (at byte offset `offset`)
+static void _add_line_starts(
+    std::vector<std::uint32_t>& line_starts, std::string_view chunk, std::uint32_t offset,
+    Encoding encoding) {
+    for_each_line_start(chunk, encoding, [&](std::size_t line_start) {
+        line_starts.push_back(offset + static_cast<std::uint32_t>(line_start));
+    });
+}
+} // namespace
+
+// class LineIndex
+LineIndex::LineIndex(std::string_view source, Encoding encoding)
+    : line_starts_{0}, encoding_(encoding) {
+    _add_line_starts(this->line_starts_, source, 0, encoding);
+}
+LineIndex::LineIndex(const Reader& reader, Encoding encoding)
+    : line_starts_{0}, encoding_(encoding) {
+    std::uint32_t byte = 0;
+    for (std::string_view chunk = reader(byte); !chunk.empty(); chunk = reader(byte)) {
+        _add_line_starts(this->line_starts_, chunk, byte, encoding);
+        byte += chunk.size();
+    }
+}
+
+LineIndex LineIndex::edited(const std::vector<AppliedEdit>& edits) const {
+    LineIndex index;
+    index.encoding_ = this->encoding_;
+    index.line_starts_.reserve(this->line_starts_.size());
+
+    const auto& old_starts = this->line_starts_;
+    auto line = old_starts.begin();
+    long byte_change = 0;
+
+    for (const auto& edit : edits) {
+        const std::uint32_t start = edit.before.start.byte;
+        const std::uint32_t end = edit.before.end.byte;
+
+        // lines before the edit only move
+        for (; line != old_starts.end() && *line <= start; ++line) {
+            index.line_starts_.push_back(static_cast<std::uint32_t>(*line + byte_change));
+        }
+        // newlines in the replaced text are removed
+        line = std::upper_bound(line, old_starts.end(), end);
+        // and newlines in the replacement are added
+        _add_line_starts(
+            index.line_starts_, edit.replacement, static_cast<std::uint32_t>(start + byte_change),
+            this->encoding_);
+
+        byte_change += static_cast<long>(edit.replacement.size()) - static_cast<long>(end - start);
+    }
+
+    for (; line != old_starts.end(); ++line) {
+        index.line_starts_.push_back(static_cast<std::uint32_t>(*line + byte_change));
+    }
+
+    return index;
+}
+
+const std::vector<std::uint32_t>& LineIndex::line_starts() const { return this->line_starts_; }
+
+std::size_t LineIndex::line_count() const { return this->line_starts_.size(); }
+
+Point LineIndex::point(std::uint32_t byte) const {
+    // the first line start after byte (there is always one before it)
+    const auto next_line =
+        std::upper_bound(this->line_starts_.begin(), this->line_starts_.end(), byte);
+    const auto row = static_cast<std::uint32_t>(next_line - this->line_starts_.begin() - 1);
+    return Point{
+        .row = row,
+        .column = byte - this->line_starts_[row],
+    };
+}
+
+Location LineIndex::location(std::uint32_t byte) const {
+    return Location{
+        .point = this->point(byte),
+        .byte = byte,
+    };
+}
+
+} // namespace ts
@@ -0,0 +1,89 @@
+#include "tree_sitter/tree_sitter.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ts {
+
+// class FileException
+FileException::FileException(const std::string& path, int error)
+    : std::runtime_error("failed to read file '" + path + "': " + std::strerror(error)),
+      error_(error) {}
+
+int FileException::error() const { return this->error_; }
+
+// helpers for Source::map_file
+namespace {
+// owner of a read-only memory mapping of a file
+class MappedFile {
+    void* data_;
+    std::size_t size_;
+
+public:
+    MappedFile(void* data, std::size_t size) noexcept : data_(data), size_(size) {}
+    ~MappedFile() noexcept { munmap(this->data_, this->size_); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) = delete;
+    MappedFile& operator=(MappedFile&&) = delete;
+
+    [[nodiscard]] std::string_view view() const noexcept {
+        return std::string_view(static_cast<const char*>(this->data_), this->size_);
+    }
+};
+
+// closes the file descriptor when going out of scope
+struct FileDescriptor {
+    int fd;
+
+    ~FileDescriptor() noexcept {
+        if (this->fd >= 0) {
+            close(this->fd);
+        }
+    }
+};
+} // namespace
+
+Source Source::map_file(std::string_view path) {
+    const std::string path_string(path);
+
+    const FileDescriptor file{open(path_string.c_str(), O_RDONLY | O_CLOEXEC)};
+    if (file.fd < 0) {
+        throw FileException(path_string, errno);
+    }
+
+    struct stat stat_buffer {};
+    if (fstat(file.fd, &stat_buffer) != 0) {
+        throw FileException(path_string, errno);
+    }
+
+    const auto size = static_cast<std::size_t>(stat_buffer.st_size);
+    if (size == 0) {
+        // empty files can't be mapped
+        return Source(std::string());
+    }
+    // Tree-Sitter uses 32 bit byte offsets
+    if (size > std::numeric_limits<std::uint32_t>::max()) {
+        throw FileException(path_string, EFBIG);
+    }
+
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file.fd, 0);
+    if (data == MAP_FAILED) {
+        throw FileException(path_string, errno);
+    }
+    // the parser reads the file from front to back
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    auto mapping = std::make_shared<const MappedFile>(data, size);
+    const std::string_view view = mapping->view();
+    return Source(view, std::move(mapping));
+}
+
+} // namespace ts
@@ -0,0 +1,194 @@
+#include "tree_sitter/tree_sitter.hpp"
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ts {
+
+// struct ParseResult
+bool ParseResult::cancelled() const { return !this->tree && !this->error; }
+
+// helpers for parse_many
+namespace {
+// queue of source indices owned by one worker
+//
+// the owner takes work from the front and other workers steal from the back
+class WorkQueue {
+    std::mutex mutex;
+    std::deque<std::size_t> indices;
+
+public:
+    void push(std::size_t index) { this->indices.push_back(index); }
+
+    std::optional<std::size_t> pop() {
+        const std::lock_guard lock(this->mutex);
+        if (this->indices.empty()) {
+            return std::nullopt;
+        }
+        const std::size_t index = this->indices.front();
+        this->indices.pop_front();
+        return index;
+    }
+
+    std::optional<std::size_t> steal() {
+        const std::lock_guard lock(this->mutex);
+        if (this->indices.empty()) {
+            return std::nullopt;
+        }
+        const std::size_t index = this->indices.back();
+        this->indices.pop_back();
+        return index;
+    }
+};
+
+// installs the cancellation flag of parse_many on a worker's parser
+// (so parses that are in progress stop as well) and restores the previous flag
+class CancellationGuard {
+    Parser& parser;
+    const std::atomic<std::size_t>* const previous;
+
+public:
+    CancellationGuard(Parser& parser, const std::atomic<std::size_t>* cancelled)
+        : parser(parser), previous(parser.cancellation_flag()) {
+        if (cancelled != nullptr) {
+            this->parser.set_cancellation_flag(cancelled);
+        }
+    }
+    ~CancellationGuard() { this->parser.set_cancellation_flag(this->previous); }
+
+    CancellationGuard(const CancellationGuard&) = delete;
+    CancellationGuard& operator=(const CancellationGuard&) = delete;
+    CancellationGuard(CancellationGuard&&) = delete;
+    CancellationGuard& operator=(CancellationGuard&&) = delete;
+};
+
+// joins the started threads when leaving the scope (also if an exception is thrown)
+class WorkerThreads {
+    std::vector<std::thread> threads;
+
+public:
+    explicit WorkerThreads(std::size_t count) { this->threads.reserve(count); }
+    ~WorkerThreads() {
+        for (auto& thread : this->threads) {
+            thread.join();
+        }
+    }
+
+    WorkerThreads(const WorkerThreads&) = delete;
+    WorkerThreads& operator=(const WorkerThreads&) = delete;
+    WorkerThreads(WorkerThreads&&) = delete;
+    WorkerThreads& operator=(WorkerThreads&&) = delete;
+
+    template <typename Fn> void start(Fn fn) { this->threads.emplace_back(std::move(fn)); }
+};
+
+class BatchParser {
+    std::vector<Source>& sources;
+    std::vector<ParseResult>& results;
+    const std::atomic<std::size_t>* cancelled;
+    std::vector<WorkQueue> queues;
+
+    [[nodiscard]] bool is_cancelled() const {
+        return this->cancelled != nullptr && this->cancelled->load(std::memory_order_relaxed) != 0;
+    }
+
+    std::optional<std::size_t> next_index(std::size_t worker) {
+        if (std::optional<std::size_t> index = this->queues[worker].pop()) {
+            return index;
+        }
+        // steal from the other workers
+        for (std::size_t offset = 1; offset < this->queues.size(); ++offset) {
+            const std::size_t victim = (worker + offset) % this->queues.size();
+            if (std::optional<std::size_t> index = this->queues[victim].steal()) {
+                return index;
+            }
+        }
+        return std::nullopt;
+    }
+
+public:
+    BatchParser(
+        std::vector<Source>& sources, std::vector<ParseResult>& results,
+        const std::atomic<std::size_t>* cancelled, std::size_t workers)
+        : sources(sources), results(results), cancelled(cancelled), queues(workers) {
+        // split the sources into contiguous blocks (one per worker)
+        for (std::size_t index = 0; index < sources.size(); ++index) {
+            this->queues[index * workers / sources.size()].push(index);
+        }
+    }
+
+    void work(std::size_t worker, Parser& parser) {
+        const CancellationGuard guard(parser, this->cancelled);
+        while (!this->is_cancelled()) {
+            const std::optional<std::size_t> index = this->next_index(worker);
+            if (!index) {
+                return;
+            }
+
+            ParseResult& result = this->results[*index];
+            try {
+                result.tree = parser.parse_source(std::move(this->sources[*index]));
+            } catch (const ParseFailureException&) {
+                // a parse that was cancelled while in progress is reported as cancelled
+                if (!this->is_cancelled()) {
+                    result.error = std::current_exception();
+                }
+            } catch (...) {
+                result.error = std::current_exception();
+            }
+        }
+    }
+};
+} // namespace
+
+std::vector<ParseResult>
+parse_many(ParserPool& pool, std::vector<Source> sources, ParseManyOptions options) {
+    std::vector<ParseResult> results(sources.size());
+    if (sources.empty()) {
+        return results;
+    }
+
+    const std::size_t max_threads = std::min(
+        {options.threads == 0 ? pool.max_size() : options.threads, pool.max_size(),
+         sources.size()});
+
+    // the calling thread always gets a parser (even if it has to wait for it)
+    // but the other workers only use parsers that are idle right now
+    std::vector<PooledParser> parsers;
+    parsers.reserve(max_threads);
+    parsers.push_back(pool.checkout());
+    while (parsers.size() < max_threads) {
+        std::optional<PooledParser> parser = pool.try_checkout();
+        if (!parser) {
+            break;
+        }
+        parsers.push_back(std::move(*parser));
+    }
+
+    BatchParser batch(sources, results, options.cancelled, parsers.size());
+
+    {
+        WorkerThreads threads(parsers.size() - 1);
+        for (std::size_t worker = 1; worker < parsers.size(); ++worker) {
+            try {
+                threads.start(
+                    [&batch, &parsers, worker]() { batch.work(worker, parsers[worker].get()); });
+            } catch (const std::system_error&) {
+                // the work of the workers that could not be started is stolen by the others
+                break;
+            }
+        }
+        batch.work(0, parsers[0].get());
+    }
+
+    return results;
+}
+
+} // namespace ts
@@ -0,0 +1,99 @@
+#include "tree_sitter/tree_sitter.hpp"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+
+namespace ts {
+
+// class PooledParser
+PooledParser::PooledParser(ParserPool& pool, Parser& parser) noexcept
+    : pool(&pool), parser(&parser) {}
+PooledParser::~PooledParser() {
+    if (this->parser != nullptr) {
+        this->pool->checkin(*this->parser);
+    }
+}
+PooledParser::PooledParser(PooledParser&& other) noexcept
+    : pool(std::exchange(other.pool, nullptr)), parser(std::exchange(other.parser, nullptr)) {}
+PooledParser& PooledParser::operator=(PooledParser&& other) noexcept {
+    PooledParser moved{std::move(other)};
+    std::swap(this->pool, moved.pool);
+    std::swap(this->parser, moved.parser);
+    return *this;
+}
+
+Parser& PooledParser::get() const { return *this->parser; }
+Parser& PooledParser::operator*() const { return this->get(); }
+Parser* PooledParser::operator->() const { return this->parser; }
+
+// class ParserPool
+static std::size_t _default_pool_size() {
+    return std::max(std::thread::hardware_concurrency(), 1U);
+}
+
+ParserPool::ParserPool(const Language& language, std::size_t max_size)
+    : language_(language), max_size_(max_size == 0 ? _default_pool_size() : max_size) {}
+
+Language ParserPool::language() const { return this->language_; }
+std::size_t ParserPool::max_size() const { return this->max_size_; }
+
+std::size_t ParserPool::size() const {
+    const std::lock_guard lock(this->mutex);
+    return this->parsers.size();
+}
+std::size_t ParserPool::idle_count() const {
+    const std::lock_guard lock(this->mutex);
+    return this->idle.size();
+}
+
+void ParserPool::checkin(Parser& parser) {
+    {
+        const std::lock_guard lock(this->mutex);
+        this->idle.push_back(&parser);
+    }
+    this->returned.notify_one();
+}
+
+std::optional<PooledParser> ParserPool::try_checkout() {
+    const std::lock_guard lock(this->mutex);
+
+    if (!this->idle.empty()) {
+        Parser* parser = this->idle.back();
+        this->idle.pop_back();
+        return PooledParser(*this, *parser);
+    }
+
+    if (this->parsers.size() < this->max_size_) {
+        auto& parser = this->parsers.emplace_back(std::make_unique<Parser>(this->language_));
+        parser->pool_ = this;
+        return PooledParser(*this, *parser);
+    }
+
+    return std::nullopt;
+}
+
+PooledParser ParserPool::checkout() {
+    while (true) {
+        if (std::optional<PooledParser> parser = this->try_checkout()) {
+            return std::move(*parser);
+        }
+
+        // wait until a parser is returned
+        std::unique_lock lock(this->mutex);
+        this->returned.wait(lock, [this]() { return !this->idle.empty(); });
+    }
+}
+
+Tree ParserPool::parse_string(std::string source) {
+    const PooledParser parser = this->checkout();
+    return parser->parse_string(std::move(source));
+}
+Tree ParserPool::parse_source(Source source) {
+    const PooledParser parser = this->checkout();
+    return parser->parse_source(std::move(source));
+}
+
+} // namespace ts
@@ -0,0 +1,109 @@
+#include "tree_sitter/tree_sitter.hpp"
+#include <algorithm>
+
+namespace ts {
+namespace {
+// edits that would create more pieces flatten the piece table instead
+constexpr std::size_t MAX_PIECES = 4096;
+} // namespace
+
+// class PieceTable
+PieceTable::PieceTable(Source source) : encoding_(source.encoding()) {
+    this->push_back(std::move(source));
+}
+
+void PieceTable::push_back(Source piece) {
+    if (piece.size() == 0) {
+        return;
+    }
+    this->piece_starts_.push_back(this->size_);
+    this->size_ += piece.size();
+    this->pieces_.push_back(std::move(piece));
+}
+
+std::uint32_t PieceTable::size() const { return this->size_; }
+
+Encoding PieceTable::encoding() const { return this->encoding_; }
+
+const std::vector<Source>& PieceTable::pieces() const { return this->pieces_; }
+
+std::string_view PieceTable::chunk(std::uint32_t byte) const {
+    if (byte >= this->size_) {
+        return {};
+    }
+
+    // the last piece that starts before (or at) byte
+    const auto next_piece =
+        std::upper_bound(this->piece_starts_.begin(), this->piece_starts_.end(), byte);
+    const auto index = static_cast<std::size_t>(next_piece - this->piece_starts_.begin() - 1);
+
+    return this->pieces_[index].view().substr(byte - this->piece_starts_[index]);
+}
+
+std::string PieceTable::text(std::uint32_t start_byte, std::uint32_t end_byte) const {
+    std::string text;
+    text.reserve(end_byte - start_byte);
+
+    std::uint32_t byte = start_byte;
+    while (byte < end_byte) {
+        const std::string_view chunk = this->chunk(byte).substr(0, end_byte - byte);
+        if (chunk.empty()) {
+            break;
+        }
+        text.append(chunk);
+        byte += chunk.size();
+    }
+
+    return text;
+}
+
+PieceTable PieceTable::edited(const std::vector<AppliedEdit>& edits) const {
+    // all replacements share one buffer
+    std::string replacements;
+    for (const auto& edit : edits) {
+        replacements.append(edit.replacement);
+    }
+    const Source replacement_buffer(std::move(replacements), this->encoding_);
+
+    PieceTable table;
+    table.encoding_ = this->encoding_;
+    table.pieces_.reserve(this->pieces_.size() + 2 * edits.size());
+    table.piece_starts_.reserve(this->pieces_.size() + 2 * edits.size());
+
+    // adds the unchanged source code between the two byte offsets
+    std::size_t piece = 0;
+    auto add_unchanged = [&](std::uint32_t start, std::uint32_t end) {
+        // skip pieces that end before start
+        while (piece < this->pieces_.size() &&
+               this->piece_starts_[piece] + this->pieces_[piece].size() <= start) {
+            ++piece;
+        }
+        for (std::size_t i = piece; i < this->pieces_.size() && this->piece_starts_[i] < end;
+             ++i) {
+            const std::uint32_t piece_start = this->piece_starts_[i];
+            const std::uint32_t from = std::max(start, piece_start) - piece_start;
+            const std::uint32_t to =
+                std::min<std::uint32_t>(end - piece_start, this->pieces_[i].size());
+            table.push_back(this->pieces_[i].substr(from, to - from));
+        }
+    };
+
+    std::uint32_t copied_until = 0;
+    std::size_t replacement_start = 0;
+    for (const auto& edit : edits) {
+        add_unchanged(copied_until, edit.before.start.byte);
+        table.push_back(replacement_buffer.substr(replacement_start, edit.replacement.size()));
+
+        copied_until = edit.before.end.byte;
+        replacement_start += edit.replacement.size();
+    }
+    add_unchanged(copied_until, this->size_);
+
+    if (table.pieces_.size() > MAX_PIECES) {
+        return PieceTable(Source(table.text(0, table.size_), this->encoding_));
+    }
+
+    return table;
+}
+
+} // namespace ts
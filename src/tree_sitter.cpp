@@ -1,7 +1,8 @@
 #include "tree_sitter/tree_sitter.hpp"
+#include "edit_helper.hpp"
 #include <algorithm>
-#include <cassert>
 #include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <iterator>
 #include <optional>
@@ -67,17 +68,28 @@ QueryException::QueryException(TSQueryError error, std::uint32_t error_offset)
 TSQueryError QueryException::query_error() const { return this->error_; }
 std::uint32_t QueryException::error_offset() const { return this->error_offset_; }
 
-// class MultilineEditException
-MultilineEditException::MultilineEditException()
-    : std::runtime_error("multiline edits are not supported") {}
-
 // class OverlppingEditException
 OverlappingEditException::OverlappingEditException()
     : std::runtime_error("overlapping edits are not allowed") {}
 
-// class ZeroSizedEditException
-ZeroSizedEditException::ZeroSizedEditException()
-    : std::runtime_error("zero-sized edits are not allowed") {}
+// class IncludedRangesException
+IncludedRangesException::IncludedRangesException()
+    : std::runtime_error("included ranges have to be sorted and must not overlap") {}
+
+// class EncodingException
+EncodingException::EncodingException()
+    : std::runtime_error("the source code of the tree has a different encoding") {}
+
+// class TextViewException
+TextViewException::TextViewException()
+    : std::runtime_error("the text is not stored in one contiguous string") {}
+
+// class FieldException
+FieldException::FieldException(const std::string& message) : std::runtime_error(message) {}
+
+// class MissingSourceException
+MissingSourceException::MissingSourceException()
+    : std::runtime_error("can't apply edits to a tree without source code") {}
 
 // struct Point
 std::string Point::pretty(bool start_at_one) const {
@@ -162,6 +174,26 @@ std::ostream& operator<<(std::ostream& o, const std::vector<Range>& ranges) {
 }
 
 // struct Edit
+Edit Edit::from_bytes(std::uint32_t start_byte, std::uint32_t end_byte, std::string replacement) {
+    return Edit{
+        .range =
+            {.start = {.point = {}, .byte = start_byte}, .end = {.point = {}, .byte = end_byte}},
+        .replacement = std::move(replacement),
+        .bytes_only = true,
+    };
+}
+// the raw bytes of the UTF-16 text (see Encoding::UTF16)
+static std::string _utf16_bytes(std::u16string_view text) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return {reinterpret_cast<const char*>(text.data()), text.size() * sizeof(char16_t)};
+}
+Edit Edit::utf16(Range range, std::u16string_view replacement) {
+    return Edit{.range = range, .replacement = _utf16_bytes(replacement)};
+}
+Edit Edit::from_bytes(
+    std::uint32_t start_byte, std::uint32_t end_byte, std::u16string_view replacement) {
+    return Edit::from_bytes(start_byte, end_byte, _utf16_bytes(replacement));
+}
 bool operator==(const Edit& lhs, const Edit& rhs) {
     return lhs.range == rhs.range && lhs.replacement == rhs.replacement;
 }
@@ -173,6 +205,54 @@ std::ostream& operator<<(std::ostream& o, const std::vector<Edit>& edits) {
     return _print_vector(o, edits);
 }
 
+// class Source
+Source::Source(std::string source)
+    : Source(std::make_shared<const std::string>(std::move(source))) {}
+Source::Source(std::shared_ptr<const std::string> source)
+    : view_(source ? std::string_view(*source) : std::string_view()), owner_(std::move(source)) {}
+Source::Source(std::string bytes, Encoding encoding) : Source(std::move(bytes)) {
+    this->encoding_ = encoding;
+}
+Source::Source(std::string_view view, std::shared_ptr<const void> owner) noexcept
+    : view_(view), owner_(std::move(owner)) {}
+
+Source Source::borrow(std::string_view view) noexcept { return Source(view, nullptr); }
+
+Source Source::utf16(std::u16string source) {
+    auto owner = std::make_shared<const std::u16string>(std::move(source));
+    const std::u16string_view view(*owner);
+    Source utf16 = borrow_utf16(view);
+    utf16.owner_ = std::move(owner);
+    return utf16;
+}
+Source Source::borrow_utf16(std::u16string_view view) noexcept {
+    // tree-sitter reads UTF-16 source code as raw bytes
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    const char* data = reinterpret_cast<const char*>(view.data());
+    Source source({data, view.size() * sizeof(char16_t)}, nullptr);
+    source.encoding_ = Encoding::UTF16;
+    return source;
+}
+
+Encoding Source::encoding() const noexcept { return this->encoding_; }
+std::string_view Source::view() const noexcept { return this->view_; }
+std::u16string_view Source::utf16_view() const {
+    if (this->encoding_ != Encoding::UTF16) {
+        throw EncodingException();
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    const auto* data = reinterpret_cast<const char16_t*>(this->view_.data());
+    return {data, this->view_.size() / sizeof(char16_t)};
+}
+const char* Source::data() const noexcept { return this->view_.data(); }
+std::size_t Source::size() const noexcept { return this->view_.size(); }
+bool Source::is_borrowed() const noexcept { return this->owner_ == nullptr; }
+Source Source::substr(std::size_t pos, std::size_t count) const {
+    Source source(this->view_.substr(pos, count), this->owner_);
+    source.encoding_ = this->encoding_;
+    return source;
+}
+
 // class Language
 Language::Language(const TSLanguage* lang) noexcept : lang(lang) {}
 
@@ -216,6 +296,91 @@ bool language_compatible(const Language& lang) {
     return lang.version() >= TREE_SITTER_MIN_VERSION && lang.version() <= TREE_SITTER_VERSION;
 }
 
+// class FieldHandle
+FieldHandle::FieldHandle(const Language& language, std::string_view name)
+    : language_(language.raw()), id_(language.field_id(name)) {
+    if (this->id_ == 0) {
+        throw FieldException("the language has no field '" + std::string(name) + "'");
+    }
+}
+
+FieldId FieldHandle::id() const noexcept { return this->id_; }
+Language FieldHandle::language() const noexcept { return Language(this->language_); }
+const char* FieldHandle::name() const { return this->language().field_name(this->id_); }
+
+// 64-bit FNV-1a (see text_hash)
+constexpr std::uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+constexpr std::uint64_t FNV_PRIME = 1099511628211ULL;
+
+static std::uint64_t _fnv_hash(std::uint64_t hash, std::string_view text) {
+    for (const char c : text) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * FNV_PRIME;
+    }
+    return hash;
+}
+
+std::uint64_t text_hash(std::string_view text) { return _fnv_hash(FNV_OFFSET_BASIS, text); }
+
+// class ChildRange
+ChildRange::ChildRange(const Node& parent, bool named_only, std::optional<FieldId> field)
+    : cursor(ts_tree_cursor_new(parent.raw())), tree(&parent.tree()), named_only(named_only),
+      field(field.value_or(0)),
+      // no child can be found by the field id 0 (see Node::children_by_field)
+      at_end(field == FieldId{0} || !ts_tree_cursor_goto_first_child(&this->cursor)) {
+    this->skip_filtered();
+}
+ChildRange::~ChildRange() { ts_tree_cursor_delete(&this->cursor); }
+
+void ChildRange::skip_filtered() {
+    auto is_filtered = [this]() {
+        if (this->field != 0 && ts_tree_cursor_current_field_id(&this->cursor) != this->field) {
+            return true;
+        }
+        return this->named_only && !ts_node_is_named(ts_tree_cursor_current_node(&this->cursor));
+    };
+    while (!this->at_end && is_filtered()) {
+        this->at_end = !ts_tree_cursor_goto_next_sibling(&this->cursor);
+    }
+}
+
+ChildRange::iterator ChildRange::begin() noexcept { return iterator(this); }
+ChildRange::iterator ChildRange::end() noexcept { return iterator(nullptr); }
+
+ChildRange::iterator::iterator(ChildRange* range) noexcept : range(range) {}
+
+bool ChildRange::iterator::at_end() const noexcept {
+    return this->range == nullptr || this->range->at_end;
+}
+
+Node ChildRange::iterator::operator*() const {
+    const TSNode node = ts_tree_cursor_current_node(&this->range->cursor);
+    return Node(Node::unsafe, node, *this->range->tree);
+}
+FieldId ChildRange::iterator::field_id() const {
+    return ts_tree_cursor_current_field_id(&this->range->cursor);
+}
+ChildRange::iterator& ChildRange::iterator::operator++() {
+    this->range->at_end = !ts_tree_cursor_goto_next_sibling(&this->range->cursor);
+    this->range->skip_filtered();
+    return *this;
+}
+ChildRange::iterator::PostfixProxy ChildRange::iterator::operator++(int) {
+    PostfixProxy previous{**this};
+    ++*this;
+    return previous;
+}
+
+ChildRange::iterator::PostfixProxy::PostfixProxy(Node node) noexcept : node(node) {}
+Node ChildRange::iterator::PostfixProxy::operator*() const noexcept { return this->node; }
+
+bool operator==(const ChildRange::iterator& lhs, const ChildRange::iterator& rhs) noexcept {
+    // all iterators of a range share the cursor, so only the end matters
+    return lhs.at_end() == rhs.at_end();
+}
+bool operator!=(const ChildRange::iterator& lhs, const ChildRange::iterator& rhs) noexcept {
+    return !(lhs == rhs);
+}
+
 // class Node
 Node::Node(Node::unsafe_t, TSNode node, const Tree& tree) noexcept : node(node), tree_(&tree) {}
 Node::Node(TSNode node, const Tree& tree) : Node(Node::unsafe, node, tree) {
@@ -255,17 +420,15 @@ std::optional<Node> Node::child(std::uint32_t index) const {
 }
 
 std::vector<Node> Node::children() const {
-    std::uint32_t num_children = this->child_count();
-
     std::vector<Node> children;
-    children.reserve(num_children);
-    for (std::uint32_t index = 0; index < num_children; ++index) {
-        // we know how many children there are so dereferencing the optional is fine
-        children.push_back(*this->child(index));
+    children.reserve(this->child_count());
+    for (const Node child : this->child_range()) {
+        children.push_back(child);
     }
 
     return children;
 }
+ChildRange Node::child_range() const { return ChildRange(*this, false); }
 
 std::uint32_t Node::named_child_count() const { return ts_node_named_child_count(this->node); }
 
@@ -274,17 +437,51 @@ std::optional<Node> Node::named_child(std::uint32_t index) const {
 }
 
 std::vector<Node> Node::named_children() const {
-    std::uint32_t num_children = this->named_child_count();
+    std::vector<Node> children;
+    children.reserve(this->named_child_count());
+    for (const Node child : this->named_child_range()) {
+        children.push_back(child);
+    }
 
+    return children;
+}
+ChildRange Node::named_child_range() const { return ChildRange(*this, true); }
+
+// the FieldId of the handle if it fits the language of the node
+static FieldId _field_id(const Node& node, const FieldHandle& field) {
+    if (field.language().raw() != node.tree().language().raw()) {
+        throw FieldException("the field '" + std::string(field.name()) +
+                             "' was resolved for a different language");
+    }
+    return field.id();
+}
+
+std::optional<Node> Node::child_by_field(FieldId field) const {
+    if (field == 0) {
+        return std::nullopt;
+    }
+    return Node::or_null(ts_node_child_by_field_id(this->node, field), this->tree());
+}
+std::optional<Node> Node::child_by_field(const FieldHandle& field) const {
+    return this->child_by_field(_field_id(*this, field));
+}
+
+std::vector<Node> Node::children_by_field(FieldId field) const {
     std::vector<Node> children;
-    children.reserve(num_children);
-    for (std::uint32_t index = 0; index < num_children; ++index) {
-        // we know how many children there are so dereferencing the optional is fine
-        children.push_back(*this->named_child(index));
+    for (const Node child : this->field_child_range(field)) {
+        children.push_back(child);
     }
 
     return children;
 }
+std::vector<Node> Node::children_by_field(const FieldHandle& field) const {
+    return this->children_by_field(_field_id(*this, field));
+}
+
+ChildRange Node::field_child_range(FieldId field) const { return ChildRange(*this, false, field); }
+ChildRange Node::field_child_range(const FieldHandle& field) const {
+    return this->field_child_range(_field_id(*this, field));
+}
 
 std::optional<Node> Node::next_sibling() const {
     return Node::or_null(ts_node_next_sibling(this->node), this->tree());
@@ -299,18 +496,36 @@ std::optional<Node> Node::prev_named_sibling() const {
     return Node::or_null(ts_node_prev_named_sibling(this->node), this->tree());
 }
 
-std::uint32_t Node::start_byte() const { return ts_node_start_byte(this->node); }
-std::uint32_t Node::end_byte() const { return ts_node_end_byte(this->node); }
+std::optional<Node> Node::first_child_for_byte(std::uint32_t byte) const {
+    return Node::or_null(ts_node_first_child_for_byte(this->node, byte), this->tree());
+}
+std::optional<Node> Node::first_named_child_for_byte(std::uint32_t byte) const {
+    return Node::or_null(ts_node_first_named_child_for_byte(this->node, byte), this->tree());
+}
 
-Point Node::start_point() const {
-    TSPoint point = ts_node_start_point(this->node);
-    return {.row = point.row, .column = point.column};
+Node Node::descendant_for_byte_range(std::uint32_t start, std::uint32_t end) const {
+    return Node(ts_node_descendant_for_byte_range(this->node, start, end), this->tree());
+}
+Node Node::descendant_for_point_range(Point start, Point end) const {
+    return Node(
+        ts_node_descendant_for_point_range(this->node, to_ts_point(start), to_ts_point(end)),
+        this->tree());
+}
+Node Node::named_descendant_for_byte_range(std::uint32_t start, std::uint32_t end) const {
+    return Node(ts_node_named_descendant_for_byte_range(this->node, start, end), this->tree());
 }
-Point Node::end_point() const {
-    TSPoint point = ts_node_end_point(this->node);
-    return {.row = point.row, .column = point.column};
+Node Node::named_descendant_for_point_range(Point start, Point end) const {
+    return Node(
+        ts_node_named_descendant_for_point_range(this->node, to_ts_point(start), to_ts_point(end)),
+        this->tree());
 }
 
+std::uint32_t Node::start_byte() const { return ts_node_start_byte(this->node); }
+std::uint32_t Node::end_byte() const { return ts_node_end_byte(this->node); }
+
+Point Node::start_point() const { return from_ts_point(ts_node_start_point(this->node)); }
+Point Node::end_point() const { return from_ts_point(ts_node_end_point(this->node)); }
+
 Location Node::start() const {
     return Location{
         .point = this->start_point(),
@@ -331,10 +546,70 @@ Range Node::range() const {
     };
 }
 
-std::string Node::text() const {
-    auto start = this->start_byte();
-    auto count = this->end_byte() - start;
-    return this->tree().source().substr(start, count);
+// the encoding of the source code (trees with a PieceTable have no Source)
+static Encoding _source_encoding(const Tree& tree) {
+    if (const PieceTable* pieces = tree.piece_table()) {
+        return pieces->encoding();
+    }
+    return tree.source_buffer().encoding();
+}
+
+std::string Node::text() const { return this->tree().text(this->start_byte(), this->end_byte()); }
+std::string_view Node::text_view() const {
+    return this->tree().text_view(this->start_byte(), this->end_byte());
+}
+bool Node::text_equals(std::string_view text) const {
+    if (_source_encoding(this->tree()) != Encoding::UTF8) {
+        throw EncodingException();
+    }
+    return this->end_byte() - this->start_byte() == text.size() && this->text_starts_with(text);
+}
+bool Node::text_starts_with(std::string_view prefix) const {
+    const Tree& tree = this->tree();
+    if (_source_encoding(tree) != Encoding::UTF8) {
+        throw EncodingException();
+    }
+
+    const std::uint32_t start = this->start_byte();
+    if (this->end_byte() - start < prefix.size()) {
+        return false;
+    }
+    if (!tree.has_reader()) {
+        return tree.source().substr(start, prefix.size()) == prefix;
+    }
+
+    // the lambda only captures one reference, so std::function doesn't allocate
+    struct {
+        std::string_view rest;
+        bool equal;
+    } state{prefix, true};
+    tree.for_each_chunk(start, start + prefix.size(), [&state](std::string_view chunk) {
+        state.equal = state.equal && state.rest.substr(0, chunk.size()) == chunk;
+        state.rest.remove_prefix(std::min(chunk.size(), state.rest.size()));
+    });
+    return state.equal && state.rest.empty();
+}
+std::uint64_t Node::text_hash() const {
+    const Tree& tree = this->tree();
+    if (!tree.has_reader() && _source_encoding(tree) == Encoding::UTF8) {
+        return ts::text_hash(
+            tree.source().substr(this->start_byte(), this->end_byte() - this->start_byte()));
+    }
+
+    std::uint64_t hash = FNV_OFFSET_BASIS;
+    tree.for_each_chunk(this->start_byte(), this->end_byte(), [&hash](std::string_view chunk) {
+        hash = _fnv_hash(hash, chunk);
+    });
+    return hash;
+}
+void Node::for_each_chunk(const std::function<void(std::string_view)>& fn) const {
+    this->tree().for_each_chunk(this->start_byte(), this->end_byte(), fn);
+}
+std::u16string Node::text_utf16() const {
+    return this->tree().text_utf16(this->start_byte(), this->end_byte());
+}
+std::u16string_view Node::text_utf16_view() const {
+    return this->tree().text_utf16_view(this->start_byte(), this->end_byte());
 }
 
 std::string Node::as_s_expr() const {
@@ -458,11 +733,22 @@ auto debug_print_node(Node node) -> std::string {
 }
 
 // class Tree
-Tree::Tree(TSTree* tree, std::string source, const Parser& parser)
+Tree::Tree(TSTree* tree, Source source, const Parser& parser)
     : tree(tree, ts_tree_delete), source_(std::move(source)), parser_(&parser) {}
+Tree::Tree(TSTree* tree, Reader reader, const Parser& parser)
+    : tree(tree, ts_tree_delete),
+      reader_(reader ? std::make_shared<const Reader>(std::move(reader)) : nullptr),
+      parser_(&parser) {}
+Tree::Tree(TSTree* tree, std::shared_ptr<const PieceTable> pieces, const Parser& parser)
+    : tree(tree, ts_tree_delete),
+      reader_(std::make_shared<const Reader>(
+          [pieces](std::uint32_t byte) { return pieces->chunk(byte); })),
+      pieces_(std::move(pieces)), parser_(&parser) {}
 
 Tree::Tree(const Tree& other)
-    : tree(ts_tree_copy(other.raw()), ts_tree_delete), source_(other.source()),
+    : tree(ts_tree_copy(other.raw()), ts_tree_delete), source_(other.source_),
+      reader_(other.reader_), pieces_(other.pieces_),
+      line_index_(std::atomic_load(&other.line_index_)), anchors_(other.anchors_),
       parser_(other.parser_) {}
 Tree& Tree::operator=(const Tree& other) {
     Tree copy{other};
@@ -474,12 +760,150 @@ void swap(Tree& self, Tree& other) noexcept {
     using std::swap;
     swap(self.tree, other.tree);
     swap(self.source_, other.source_);
+    swap(self.reader_, other.reader_);
+    swap(self.pieces_, other.pieces_);
+    swap(self.line_index_, other.line_index_);
+    swap(self.anchors_, other.anchors_);
     swap(self.parser_, other.parser_);
 }
 
 const TSTree* Tree::raw() const { return this->tree.get(); }
 
-const std::string& Tree::source() const { return this->source_; }
+std::string_view Tree::source() const { return this->source_.view(); }
+
+bool Tree::has_reader() const { return this->reader_ != nullptr; }
+
+const PieceTable* Tree::piece_table() const { return this->pieces_.get(); }
+
+const Source& Tree::source_buffer() const { return this->source_; }
+
+std::string Tree::text(std::uint32_t start_byte, std::uint32_t end_byte) const {
+    std::string text;
+    text.reserve(end_byte - start_byte);
+
+    this->for_each_chunk(
+        start_byte, end_byte, [&text](std::string_view chunk) { text.append(chunk); });
+
+    return text;
+}
+
+void Tree::for_each_chunk(
+    std::uint32_t start_byte, std::uint32_t end_byte,
+    const std::function<void(std::string_view)>& fn) const {
+    if (_source_encoding(*this) != Encoding::UTF8) {
+        throw EncodingException();
+    }
+    this->for_each_byte_chunk(start_byte, end_byte, fn);
+}
+void Tree::for_each_byte_chunk(
+    std::uint32_t start_byte, std::uint32_t end_byte,
+    const std::function<void(std::string_view)>& fn) const {
+    if (!this->has_reader()) {
+        fn(this->source().substr(start_byte, end_byte - start_byte));
+        return;
+    }
+
+    std::uint32_t byte = start_byte;
+    while (byte < end_byte) {
+        std::string_view chunk = (*this->reader_)(byte);
+        if (chunk.empty()) {
+            break;
+        }
+        chunk = chunk.substr(0, end_byte - byte);
+        fn(chunk);
+        byte += chunk.size();
+    }
+}
+
+std::string_view Tree::text_view(std::uint32_t start_byte, std::uint32_t end_byte) const {
+    if (_source_encoding(*this) != Encoding::UTF8) {
+        throw EncodingException();
+    }
+    return this->byte_view(start_byte, end_byte);
+}
+std::string_view Tree::byte_view(std::uint32_t start_byte, std::uint32_t end_byte) const {
+    if (!this->has_reader()) {
+        return this->source().substr(start_byte, end_byte - start_byte);
+    }
+    if (this->pieces_ != nullptr) {
+        // the pieces are owned by the tree (chunks of other readers are only
+        // valid while reading them)
+        const std::string_view chunk = this->pieces_->chunk(start_byte);
+        if (chunk.size() >= end_byte - start_byte) {
+            return chunk.substr(0, end_byte - start_byte);
+        }
+    }
+    throw TextViewException();
+}
+
+std::u16string Tree::text_utf16(std::uint32_t start_byte, std::uint32_t end_byte) const {
+    if (_source_encoding(*this) != Encoding::UTF16) {
+        throw EncodingException();
+    }
+
+    // the chunks are copied as bytes because they might not be aligned for char16_t
+    std::u16string text((end_byte - start_byte) / sizeof(char16_t), u'\0');
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    char* out = reinterpret_cast<char*>(text.data());
+    std::size_t copied = 0;
+    this->for_each_byte_chunk(start_byte, end_byte, [&](std::string_view chunk) {
+        chunk = chunk.substr(0, text.size() * sizeof(char16_t) - copied);
+        std::memcpy(out + copied, chunk.data(), chunk.size());
+        copied += chunk.size();
+    });
+    text.resize(copied / sizeof(char16_t));
+    return text;
+}
+
+std::u16string_view
+Tree::text_utf16_view(std::uint32_t start_byte, std::uint32_t end_byte) const {
+    if (_source_encoding(*this) != Encoding::UTF16) {
+        throw EncodingException();
+    }
+    const std::string_view bytes = this->byte_view(start_byte, end_byte);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    const auto* data = reinterpret_cast<const char16_t*>(bytes.data());
+    return {data, bytes.size() / sizeof(char16_t)};
+}
+
+const LineIndex& Tree::line_index() const {
+    const Encoding encoding = _source_encoding(*this);
+
+    // the tree might be shared by multiple threads, so only the first created
+    // index is stored and all others are discarded
+    std::shared_ptr<const LineIndex> index = std::atomic_load(&this->line_index_);
+    if (index == nullptr) {
+        auto new_index = this->has_reader()
+                             ? std::make_shared<const LineIndex>(*this->reader_, encoding)
+                             : std::make_shared<const LineIndex>(this->source(), encoding);
+        if (std::atomic_compare_exchange_strong(&this->line_index_, &index, new_index)) {
+            index = new_index;
+        }
+    }
+    return *index;
+}
+
+AnchorSet& Tree::unique_anchors() {
+    if (this->anchors_ == nullptr) {
+        this->anchors_ = std::make_shared<AnchorSet>();
+    } else if (this->anchors_.use_count() > 1) {
+        this->anchors_ = std::make_shared<AnchorSet>(*this->anchors_);
+    }
+    return *this->anchors_;
+}
+
+AnchorSet::Id Tree::add_anchor(Range range) { return this->unique_anchors().add(range); }
+
+void Tree::remove_anchor(AnchorSet::Id id) {
+    if (this->anchors_ != nullptr) {
+        this->unique_anchors().remove(id);
+    }
+}
+
+const AnchorSet& Tree::anchors() const {
+    static const AnchorSet no_anchors;
+    return this->anchors_ != nullptr ? *this->anchors_ : no_anchors;
+}
 
 const Parser& Tree::parser() const { return *this->parser_; }
 
@@ -487,10 +911,143 @@ Node Tree::root_node() const { return Node(Node::unsafe, ts_tree_root_node(this-
 
 Language Tree::language() const { return Language(ts_tree_language(this->raw())); }
 
-EditResult Tree::edit(std::vector<Edit> edits) {
-    const std::unique_ptr<TSTree, void (*)(TSTree*)> old_tree = std::move(this->tree);
+static bool _has_bytes_only_edits(const std::vector<Edit>& edits) {
+    return std::any_of(
+        edits.begin(), edits.end(), [](const Edit& edit) { return edit.bytes_only; });
+}
+
+// computes the points of edits created with Edit::from_bytes
+static void _compute_points(std::vector<Edit>& edits, const LineIndex& index) {
+    for (auto& edit : edits) {
+        if (edit.bytes_only) {
+            edit.range.start = index.location(edit.range.start.byte);
+            edit.range.end = index.location(edit.range.end.byte);
+            edit.bytes_only = false;
+        }
+    }
+}
+
+// the anchors moved along with the edits (they are copied if they are shared with another tree)
+static std::shared_ptr<AnchorSet>
+_rebase_anchors(std::shared_ptr<AnchorSet> anchors, const std::vector<AppliedEdit>& edits) {
+    if (anchors == nullptr) {
+        return nullptr;
+    }
+    if (anchors.use_count() > 1) {
+        anchors = std::make_shared<AnchorSet>(*anchors);
+    }
+    anchors->rebase(edits);
+    return anchors;
+}
+
+// calls fn with a parser that can be used for reparsing a tree created by `parser`
+template <typename Fn> static EditResult _with_reparse_parser(const Parser& parser, Fn fn) {
+    if (ParserPool* pool = parser.pool()) {
+        // the original parser might be in use by another thread
+        const PooledParser pooled_parser = pool->checkout();
+        return fn(*pooled_parser);
+    }
+    return fn(parser);
+}
+
+EditResult Tree::edit(std::vector<Edit> edits, EditOptions options) {
+    if (this->has_reader() && this->pieces_ == nullptr) {
+        throw MissingSourceException();
+    }
+
+    if (_has_bytes_only_edits(edits)) {
+        _compute_points(edits, this->line_index());
+    }
+    const std::shared_ptr<const LineIndex> line_index = this->line_index_;
+    // edit_tree replaces this tree with the reparsed one (without anchors) only if it
+    // succeeds, otherwise the anchors stay in place
+    std::shared_ptr<AnchorSet> anchors = this->anchors_;
 
-    return edit_tree(std::move(edits), *this, old_tree.get());
+    EditResult result = _with_reparse_parser(this->parser(), [&](const Parser& parser) {
+        const std::unique_ptr<TSTree, void (*)(TSTree*)> old_tree = std::move(this->tree);
+
+        if (const std::shared_ptr<const PieceTable> pieces = this->pieces_) {
+            return edit_tree(std::move(edits), *this, old_tree.get(), parser, *pieces, options);
+        }
+        return edit_tree(std::move(edits), *this, old_tree.get(), parser, options);
+    });
+
+    // update the line index without scanning the new source code
+    if (line_index != nullptr) {
+        this->line_index_ =
+            std::make_shared<const LineIndex>(line_index->edited(result.applied_edits));
+    }
+    this->anchors_ = _rebase_anchors(std::move(anchors), result.applied_edits);
+    return result;
+}
+EditResult Tree::edit(std::vector<Edit> edits, Reader new_source, EditOptions options) {
+    if (_has_bytes_only_edits(edits)) {
+        _compute_points(edits, this->line_index());
+    }
+    const std::shared_ptr<const LineIndex> line_index = this->line_index_;
+    // edit_tree replaces this tree with the reparsed one (without anchors) only if it
+    // succeeds, otherwise the anchors stay in place
+    std::shared_ptr<AnchorSet> anchors = this->anchors_;
+
+    EditResult result = _with_reparse_parser(this->parser(), [&](const Parser& parser) {
+        const std::unique_ptr<TSTree, void (*)(TSTree*)> old_tree = std::move(this->tree);
+
+        return edit_tree(
+            std::move(edits), *this, old_tree.get(), parser, std::move(new_source), options);
+    });
+
+    // update the line index without scanning the new source code
+    if (line_index != nullptr) {
+        this->line_index_ =
+            std::make_shared<const LineIndex>(line_index->edited(result.applied_edits));
+    }
+    this->anchors_ = _rebase_anchors(std::move(anchors), result.applied_edits);
+    return result;
+}
+
+EditResult Tree::update_source(std::string_view new_source, EditOptions options) {
+    if (this->has_reader() && this->pieces_ == nullptr) {
+        throw MissingSourceException();
+    }
+    if (_source_encoding(*this) != Encoding::UTF8) {
+        throw EncodingException();
+    }
+
+    std::vector<Edit> edits;
+    if (const PieceTable* pieces = this->piece_table()) {
+        edits = diff_edits(pieces->text(0, pieces->size()), new_source);
+    } else {
+        edits = diff_edits(this->source(), new_source);
+    }
+
+    if (edits.empty()) {
+        return EditResult{};
+    }
+    return this->edit(std::move(edits), options);
+}
+EditResult Tree::update_source(std::u16string_view new_source, EditOptions options) {
+    if (this->has_reader() && this->pieces_ == nullptr) {
+        throw MissingSourceException();
+    }
+    if (_source_encoding(*this) != Encoding::UTF16) {
+        throw EncodingException();
+    }
+
+    std::vector<Edit> edits;
+    if (const PieceTable* pieces = this->piece_table()) {
+        // copied so the code units are aligned
+        const std::string bytes = pieces->text(0, pieces->size());
+        std::u16string old_source(bytes.size() / sizeof(char16_t), u'\0');
+        std::memcpy(old_source.data(), bytes.data(), old_source.size() * sizeof(char16_t));
+        edits = diff_edits(old_source, new_source);
+    } else {
+        edits = diff_edits(this->source_.utf16_view(), new_source);
+    }
+
+    if (edits.empty()) {
+        return EditResult{};
+    }
+    return this->edit(std::move(edits), options);
 }
 
 void Tree::print_dot_graph(std::string_view file) const {
@@ -498,20 +1055,92 @@ void Tree::print_dot_graph(std::string_view file) const {
     ts_tree_print_dot_graph(this->raw(), f.get());
 }
 
-// helpers to implement visit_tree
-static void _visit_siblings(Cursor& cursor, const std::function<void(ts::Node)>& fn) {
-    while (cursor.goto_next_sibling()) {
-        fn(cursor.current_node());
-        visit_children(cursor, fn);
-    }
-    assert(cursor.goto_parent());
-};
 void visit_children(Cursor& cursor, const std::function<void(ts::Node)>& fn) {
-    if (cursor.goto_first_child()) {
-        fn(cursor.current_node());
-        _visit_siblings(cursor, fn);
+    if (!cursor.goto_first_child()) {
+        return;
+    }
+    do {
+        visit_preorder(cursor, fn);
+    } while (cursor.goto_next_sibling());
+    cursor.goto_parent();
+}
+
+// class PendingEdits
+static PieceTable _piece_table(const Tree& tree) {
+    if (const PieceTable* pieces = tree.piece_table()) {
+        return *pieces;
+    }
+    if (tree.has_reader()) {
+        throw MissingSourceException();
+    }
+    return PieceTable(tree.source_buffer());
+}
+
+PendingEdits::PendingEdits(Tree tree, EditOptions options)
+    : tree_(std::move(tree)), source_(_piece_table(this->tree_)),
+      edited_tree_(nullptr, ts_tree_delete), options_(options) {}
+
+std::vector<AppliedEdit> PendingEdits::edit(std::vector<Edit> edits) {
+    if (_has_bytes_only_edits(edits)) {
+        if (!this->line_index_) {
+            this->line_index_.emplace(
+                [this](std::uint32_t byte) { return this->source_.chunk(byte); },
+                this->source_.encoding());
+        }
+        _compute_points(edits, *this->line_index_);
+    }
+
+    if (this->edited_tree_ == nullptr) {
+        this->edited_tree_.reset(ts_tree_copy(this->tree_.raw()));
+    }
+
+    std::vector<AppliedEdit> applied_edits =
+        apply_edits(std::move(edits), this->edited_tree_.get(), this->source_, this->options_);
+
+    if (this->line_index_) {
+        this->line_index_ = this->line_index_->edited(applied_edits);
+    }
+    // the anchors are already moved to their locations after the pending edits
+    this->tree_.anchors_ = _rebase_anchors(std::move(this->tree_.anchors_), applied_edits);
+    this->pending_.insert(this->pending_.end(), applied_edits.begin(), applied_edits.end());
+
+    return applied_edits;
+}
+
+bool PendingEdits::has_pending() const { return this->edited_tree_ != nullptr; }
+
+const PieceTable& PendingEdits::source() const { return this->source_; }
+
+const AnchorSet& PendingEdits::anchors() const { return this->tree_.anchors(); }
+
+EditResult PendingEdits::flush() {
+    if (!this->has_pending()) {
+        return EditResult{};
     }
-};
+
+    // reparse_tree replaces the tree (without anchors) only if it succeeds
+    std::shared_ptr<AnchorSet> anchors = this->tree_.anchors_;
+    this->last_result_ = _with_reparse_parser(this->tree_.parser(), [&](const Parser& parser) {
+        return reparse_tree(
+            this->tree_, this->edited_tree_.get(), parser, this->source_,
+            std::move(this->pending_), this->options_);
+    });
+
+    this->tree_.anchors_ = std::move(anchors);
+    this->edited_tree_.reset();
+    this->pending_.clear();
+
+    return this->last_result_;
+}
+
+const EditResult& PendingEdits::last_result() const { return this->last_result_; }
+
+const Tree& PendingEdits::tree() {
+    this->flush();
+    return this->tree_;
+}
+
+Node PendingEdits::root_node() { return this->tree().root_node(); }
 
 // class Cursor
 Cursor::Cursor(Node node) noexcept : cursor(ts_tree_cursor_new(node.raw())), tree(&node.tree()) {}
@@ -548,6 +1177,13 @@ FieldId Cursor::current_field_id() const { return ts_tree_cursor_current_field_i
 bool Cursor::goto_parent() { return ts_tree_cursor_goto_parent(&this->cursor); }
 bool Cursor::goto_first_child() { return ts_tree_cursor_goto_first_child(&this->cursor); }
 bool Cursor::goto_next_sibling() { return ts_tree_cursor_goto_next_sibling(&this->cursor); }
+std::optional<std::uint32_t> Cursor::goto_first_child_for_byte(std::uint32_t byte) {
+    const std::int64_t index = ts_tree_cursor_goto_first_child_for_byte(&this->cursor, byte);
+    if (index < 0) {
+        return std::nullopt;
+    }
+    return static_cast<std::uint32_t>(index);
+}
 int Cursor::skip_n_siblings(int n) {
     int i = 0;
     for (; i < n; ++i) {
@@ -617,6 +1253,17 @@ std::vector<Node> Cursor::named_children() {
     return children;
 }
 
+// class ReparsePolicy
+bool ReparsePolicy::full_reparse(
+    std::size_t edit_count, std::size_t touched_bytes, std::size_t source_size) const {
+    if (source_size < this->min_source_size) {
+        return false;
+    }
+    return edit_count > this->max_incremental_edits ||
+           static_cast<double>(touched_bytes) >
+               this->max_touched_fraction * static_cast<double>(source_size);
+}
+
 // class Parser
 Parser::Parser(const Language& lang) : parser(ts_parser_new(), ts_parser_delete) {
     if (!ts_parser_set_language(this->parser.get(), lang.raw())) {
@@ -632,22 +1279,192 @@ TSParser* Parser::raw() const { return this->parser.get(); }
 
 Language Parser::language() const { return Language(ts_parser_language(this->raw())); }
 
-Tree Parser::parse_string(const TSTree* old_tree, std::string source) const {
-    TSTree* tree = ts_parser_parse_string(this->raw(), old_tree, source.c_str(), source.length());
+ParserPool* Parser::pool() const { return this->pool_; }
+
+void Parser::set_timeout_micros(std::uint64_t timeout) {
+    ts_parser_set_timeout_micros(this->raw(), timeout);
+}
+std::uint64_t Parser::timeout_micros() const { return ts_parser_timeout_micros(this->raw()); }
+
+// tree-sitter reads the flag with an atomic load on the plain size_t
+static_assert(sizeof(std::atomic<std::size_t>) == sizeof(std::size_t));
+
+void Parser::set_cancellation_flag(const std::atomic<std::size_t>* flag) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    ts_parser_set_cancellation_flag(this->raw(), reinterpret_cast<const std::size_t*>(flag));
+}
+const std::atomic<std::size_t>* Parser::cancellation_flag() const {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    return reinterpret_cast<const std::atomic<std::size_t>*>(
+        ts_parser_cancellation_flag(this->raw()));
+}
+
+void Parser::reset() const { ts_parser_reset(this->raw()); }
+
+void Parser::set_included_ranges(const std::vector<Range>& ranges) {
+    std::vector<TSRange> raw_ranges;
+    raw_ranges.reserve(ranges.size());
+
+    for (std::size_t i = 0; i < ranges.size(); ++i) {
+        const Range& range = ranges[i];
+        if (range.end < range.start || (i > 0 && range.start < ranges[i - 1].end)) {
+            throw IncludedRangesException();
+        }
+        raw_ranges.push_back(TSRange{
+            .start_point = to_ts_point(range.start.point),
+            .end_point = to_ts_point(range.end.point),
+            .start_byte = range.start.byte,
+            .end_byte = range.end.byte,
+        });
+    }
+
+    ts_parser_set_included_ranges(
+        this->raw(), raw_ranges.data(), static_cast<std::uint32_t>(raw_ranges.size()));
+}
+std::vector<Range> Parser::included_ranges() const {
+    std::uint32_t length = 0;
+    const TSRange* raw_ranges = ts_parser_included_ranges(this->raw(), &length);
+
+    std::vector<Range> ranges;
+    ranges.reserve(length);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    std::for_each(raw_ranges, raw_ranges + length, [&ranges](const TSRange& range) {
+        ranges.push_back(Range{
+            .start = {.point = from_ts_point(range.start_point), .byte = range.start_byte},
+            .end = {.point = from_ts_point(range.end_point), .byte = range.end_byte},
+        });
+    });
+    return ranges;
+}
+
+static TSInputEncoding _input_encoding(const Encoding encoding) {
+    switch (encoding) {
+    case Encoding::UTF8:
+        return TSInputEncodingUTF8;
+    case Encoding::UTF16:
+        return TSInputEncodingUTF16;
+    }
+    return TSInputEncodingUTF8;
+}
+
+static TSTree* _parse_source(const Parser& parser, const TSTree* old_tree, const Source& source) {
+    return ts_parser_parse_string_encoding(
+        parser.raw(), old_tree, source.data(), source.size(), _input_encoding(source.encoding()));
+}
+
+Tree Parser::parse_source(const TSTree* old_tree, Source source) const {
+    TSTree* tree = _parse_source(*this, old_tree, source);
     if (tree == nullptr) {
-        // TL;DR this should never happen
         // This can occur when:
         // - there is no language set (should not happen because we manage that)
         // - or the timeout was reached (see ts_parser_set_timeout_micros)
         // - or the parsing was cancelled using ts_parser_set_cancellation_flag
         // In the latter two cases the parser could be restarted by calling it
-        // with the same arguments. But these cases also can't happen because
-        // we don't allow setting those flags.
+        // with the same arguments. But we don't keep the arguments around
+        // (see ParseTask for that) so we have to discard the parse state.
+        this->reset();
         throw ParseFailureException();
     }
     return Tree(tree, std::move(source), *this);
 }
+Tree Parser::parse_source(Source source) const { return parse_source(nullptr, std::move(source)); }
+Tree Parser::parse_file(std::string_view path) const {
+    return parse_source(nullptr, Source::map_file(path));
+}
+
+// adapter from the TSInput callback to a Reader
+static const char*
+_read_chunk(void* payload, std::uint32_t byte, TSPoint /*point*/, std::uint32_t* bytes_read) {
+    const Reader& reader = *static_cast<const Reader*>(payload);
+    const std::string_view chunk = reader(byte);
+    *bytes_read = static_cast<std::uint32_t>(chunk.size());
+    return chunk.data();
+}
+
+// adapter from the TSInput callback to a PieceTable
+static const char*
+_read_piece(void* payload, std::uint32_t byte, TSPoint /*point*/, std::uint32_t* bytes_read) {
+    const PieceTable& pieces = *static_cast<const PieceTable*>(payload);
+    const std::string_view chunk = pieces.chunk(byte);
+    *bytes_read = static_cast<std::uint32_t>(chunk.size());
+    return chunk.data();
+}
+
+static TSTree* _parse_input(const Parser& parser, const TSTree* old_tree, const TSInput& input) {
+    TSTree* tree = ts_parser_parse(parser.raw(), old_tree, input);
+    if (tree == nullptr) {
+        // see Parser::parse_source
+        parser.reset();
+        throw ParseFailureException();
+    }
+    return tree;
+}
+
+Tree Parser::parse(const TSTree* old_tree, Reader reader) const {
+    const TSInput input{
+        .payload = &reader,
+        .read = _read_chunk,
+        .encoding = TSInputEncodingUTF8,
+    };
+    TSTree* tree = _parse_input(*this, old_tree, input);
+    return Tree(tree, std::move(reader), *this);
+}
+Tree Parser::parse(Reader reader) const { return parse(nullptr, std::move(reader)); }
+Tree Parser::parse_piece_table(const TSTree* old_tree, PieceTable pieces) const {
+    const TSInput input{
+        .payload = &pieces,
+        .read = _read_piece,
+        .encoding = _input_encoding(pieces.encoding()),
+    };
+    TSTree* tree = _parse_input(*this, old_tree, input);
+    // moving the piece table keeps the pieces (and their text) in place
+    return Tree(tree, std::make_shared<const PieceTable>(std::move(pieces)), *this);
+}
+Tree Parser::parse_piece_table(PieceTable pieces) const {
+    return parse_piece_table(nullptr, std::move(pieces));
+}
+Tree Parser::parse_string(const TSTree* old_tree, std::string source) const {
+    return parse_source(old_tree, Source(std::move(source)));
+}
 Tree Parser::parse_string(std::string str) const { return parse_string(nullptr, std::move(str)); }
+Tree Parser::parse_string_utf16(std::u16string_view source) const {
+    return parse_source(nullptr, Source::utf16(std::u16string(source)));
+}
+
+// class ParseTask
+ParseTask::ParseTask(const Parser& parser, Source source) noexcept
+    : parser(&parser), source(std::move(source)) {}
+ParseTask::~ParseTask() { this->cancel(); }
+ParseTask::ParseTask(ParseTask&& other) noexcept
+    : parser(other.parser), source(std::move(other.source)),
+      running(std::exchange(other.running, false)) {}
+ParseTask& ParseTask::operator=(ParseTask&& other) noexcept {
+    this->cancel();
+    this->parser = other.parser;
+    this->source = std::move(other.source);
+    this->running = std::exchange(other.running, false);
+    return *this;
+}
+
+std::optional<Tree> ParseTask::resume() {
+    // parsing again with the same arguments resumes a halted parse
+    TSTree* tree = _parse_source(*this->parser, nullptr, this->source);
+    if (tree == nullptr) {
+        this->running = true;
+        return std::nullopt;
+    }
+    this->running = false;
+    return Tree(tree, this->source, *this->parser);
+}
+
+bool ParseTask::is_running() const { return this->running; }
+
+void ParseTask::cancel() {
+    if (this->running) {
+        this->parser->reset();
+        this->running = false;
+    }
+}
 
 // class Query
 static TSQuery* _make_query(const Language& language, std::string_view source) {
@@ -0,0 +1,146 @@
+#include <catch2/catch.hpp>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "tree_sitter/tree_sitter.hpp"
+
+extern "C" const TSLanguage* tree_sitter_lua();
+static const ts::Language LUA_LANGUAGE{tree_sitter_lua()};
+
+namespace {
+const std::string LINE = "local abc = 1\n";
+const std::uint32_t IDENT_COLUMN = 6;
+const std::uint32_t IDENT_SIZE = 3;
+
+// source code with one local variable declaration per line
+std::string make_source(std::size_t lines) {
+    std::string source;
+    source.reserve(lines * LINE.size());
+    for (std::size_t i = 0; i < lines; ++i) {
+        source.append(LINE);
+    }
+    return source;
+}
+
+// renames the variable in every line
+std::vector<ts::Edit> make_renames(std::size_t lines) {
+    std::vector<ts::Edit> edits;
+    edits.reserve(lines);
+    for (std::uint32_t row = 0; row < lines; ++row) {
+        const std::uint32_t byte = row * LINE.size() + IDENT_COLUMN;
+        edits.push_back(ts::Edit{
+            .range =
+                {.start = {.point = {.row = row, .column = IDENT_COLUMN}, .byte = byte},
+                 .end =
+                     {.point = {.row = row, .column = IDENT_COLUMN + IDENT_SIZE},
+                      .byte = byte + IDENT_SIZE}},
+            .replacement = "renamed",
+        });
+    }
+    return edits;
+}
+
+const std::string FUNCTION = R"-(function f(a, b)
+    if a > b then
+        for i = 1, 10 do
+            b = b + a * i
+        end
+    end
+    return b
+end
+)-";
+
+// source code with many functions containing nested blocks
+std::string make_functions(std::size_t functions) {
+    std::string source;
+    source.reserve(functions * FUNCTION.size());
+    for (std::size_t i = 0; i < functions; ++i) {
+        source.append(FUNCTION);
+    }
+    return source;
+}
+
+// how visit_tree was implemented before visit_preorder (recursive with std::function)
+void visit_recursive(ts::Cursor& cursor, const std::function<void(ts::Node)>& fn) {
+    fn(cursor.current_node());
+    if (cursor.goto_first_child()) {
+        do {
+            visit_recursive(cursor, fn);
+        } while (cursor.goto_next_sibling());
+        cursor.goto_parent();
+    }
+}
+} // namespace
+
+TEST_CASE("edit_tree scales linearly with the number of edits", "[benchmark]") {
+    ts::Parser parser(LUA_LANGUAGE);
+
+    // without a policy the edits are always reparsed incrementally
+    const ts::EditOptions incremental{};
+    const ts::EditOptions full{
+        .reparse_policy =
+            ts::ReparsePolicy{
+                .min_source_size = 0,
+                .max_incremental_edits = 0,
+                .max_touched_fraction = 0,
+            },
+    };
+
+    for (const std::size_t lines : {1, 10, 100, 1000, 10000, 100000}) {
+        const ts::Tree tree = parser.parse_string(make_source(lines));
+        const std::vector<ts::Edit> edits = make_renames(lines);
+
+        for (const auto& run : {std::pair{"incremental", incremental}, {"full", full}}) {
+            // (structured bindings can't be captured by the lambdas below)
+            const std::string name = run.first;
+            const ts::EditOptions& options = run.second;
+
+            BENCHMARK_ADVANCED(
+                "rename " + std::to_string(lines) + " variables (" + name + " reparse)")
+            (Catch::Benchmark::Chronometer meter) {
+                // tree copies are cheap and share the source code
+                std::vector<ts::Tree> trees(meter.runs(), tree);
+                std::vector<std::vector<ts::Edit>> edits_per_run(meter.runs(), edits);
+
+                meter.measure(
+                    [&](int i) { return trees[i].edit(std::move(edits_per_run[i]), options); });
+            };
+        }
+    }
+}
+
+TEST_CASE("visiting all nodes of a tree", "[benchmark]") {
+    ts::Parser parser(LUA_LANGUAGE);
+
+    for (const std::size_t functions : {100, 10000}) {
+        const ts::Tree tree = parser.parse_string(make_functions(functions));
+        const std::string suffix = " (" + std::to_string(functions) + " functions)";
+
+        BENCHMARK("recursive with std::function" + suffix) {
+            std::size_t count = 0;
+            ts::Cursor cursor{tree};
+            visit_recursive(cursor, [&](ts::Node) { ++count; });
+            return count;
+        };
+
+        BENCHMARK("visit_children with std::function" + suffix) {
+            std::size_t count = 1;
+            ts::Cursor cursor{tree};
+            ts::visit_children(cursor, [&](ts::Node) { ++count; });
+            return count;
+        };
+
+        BENCHMARK("visit_preorder" + suffix) {
+            std::size_t count = 0;
+            ts::visit_preorder(tree.root_node(), [&](ts::Node) { ++count; });
+            return count;
+        };
+
+        BENCHMARK("visit_postorder" + suffix) {
+            std::size_t count = 0;
+            ts::visit_postorder(tree.root_node(), [&](ts::Node) { ++count; });
+            return count;
+        };
+    }
+}
@@ -1,7 +1,11 @@
+#include <algorithm>
 #include <catch2/catch.hpp>
+#include <cstdio>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <thread>
 #include <type_traits>
 
 #include "tree_sitter/tree_sitter.hpp"
@@ -352,6 +356,527 @@ TEST_CASE("tree can be copied", "[tree-sitter]") {
     CHECK(tree.source() == tree2.source());
 
     CHECK(&tree.root_node().tree() != &tree_copy.root_node().tree());
+
+    SECTION("copies share the source code") {
+        CHECK(tree.source().data() == tree_copy.source().data());
+        CHECK(tree.source().data() == tree2.source().data());
+    }
+
+    SECTION("editing a copy does not change the original") {
+        ts::Node binary_operation =
+            tree_copy.root_node().named_child(0).value().named_child(0).value();
+        ts::Node number_1 = binary_operation.named_child(0).value();
+        tree_copy.edit({ts::Edit{.range = number_1.range(), .replacement = "4"}});
+
+        CHECK(tree_copy.source() == "4 + 2"s);
+        CHECK(tree.source() == source);
+        CHECK(tree.root_node().text() == source);
+    }
+}
+
+TEST_CASE("trees can be parsed without copying the source", "[tree-sitter]") {
+    ts::Parser parser(LUA_LANGUAGE);
+
+    SECTION("from a shared buffer") {
+        auto buffer = std::make_shared<const std::string>("1 + 2");
+        ts::Tree tree = parser.parse_source(buffer);
+
+        CHECK(tree.source().data() == buffer->data());
+        CHECK(tree.source() == "1 + 2"s);
+
+        ts::Node number_2 =
+            tree.root_node().named_child(0).value().named_child(0).value().named_child(1).value();
+        CHECK(number_2.text() == "2"s);
+    }
+
+    SECTION("shared buffer is kept alive by the tree") {
+        auto buffer = std::make_shared<const std::string>("1 + 2");
+        ts::Tree tree = parser.parse_source(buffer);
+        buffer.reset();
+
+        ts::Node number_1 =
+            tree.root_node().named_child(0).value().named_child(0).value().named_child(0).value();
+        CHECK(number_1.text() == "1"s);
+    }
+
+    SECTION("from a borrowed string") {
+        const std::string source = "local a = 1";
+        ts::Source borrowed = ts::Source::borrow(source);
+        CHECK(borrowed.is_borrowed());
+
+        ts::Tree tree = parser.parse_source(borrowed);
+
+        CHECK(tree.source().data() == source.data());
+        ts::Node number = tree.root_node().named_child(0).value().named_child(1).value();
+        CHECK(number.text() == "1"s);
+    }
+}
+
+TEST_CASE("trees can be parsed from files", "[tree-sitter]") {
+    ts::Parser parser(LUA_LANGUAGE);
+
+    SECTION("file is mapped and kept alive by the tree") {
+        const std::string path = "parse_file_test.lua";
+        {
+            std::ofstream ofs(path);
+            ofs << "local a = 1\nreturn a";
+        }
+
+        ts::Tree tree = parser.parse_file(path);
+        std::remove(path.c_str());
+
+        CHECK(tree.source() == "local a = 1\nreturn a"s);
+        CHECK(!tree.root_node().has_error());
+        ts::Node number = tree.root_node().named_child(0).value().named_child(1).value();
+        CHECK(number.text() == "1"s);
+    }
+
+    SECTION("missing files throw an exception") {
+        REQUIRE_THROWS_AS(parser.parse_file("does_not_exist.lua"), ts::FileException);
+    }
+}
+
+TEST_CASE("trees can be parsed from a chunked reader", "[tree-sitter]") {
+    ts::Parser parser(LUA_LANGUAGE);
+
+    // reads the source code in chunks of at most 3 bytes
+    auto chunked_reader = [](const std::string& source) {
+        return [&source](std::uint32_t byte) -> std::string_view {
+            if (byte >= source.size()) {
+                return {};
+            }
+            return std::string_view(source).substr(byte, 3);
+        };
+    };
+
+    std::string source = "local abc = 1 + 2";
+    ts::Tree tree = parser.parse(chunked_reader(source));
+
+    CHECK(tree.has_reader());
+    CHECK(tree.source().empty());
+    CHECK(!tree.root_node().has_error());
+
+    ts::Node ident = tree.root_node().named_child(0).value().named_child(0).value();
+    CHECK(ident.type() == "identifier"s);
+    CHECK(ident.text() == "abc"s);
+    CHECK(tree.root_node().text() == source);
+
+    SECTION("can't be edited without a new reader") {
+        ts::Edit edit{.range = ident.range(), .replacement = "x"};
+        REQUIRE_THROWS_AS(tree.edit({edit}), ts::MissingSourceException);
+    }
+
+    SECTION("can be edited with a new reader") {
+        ts::Edit edit{.range = ident.range(), .replacement = "x"};
+        std::string new_source = "local x = 1 + 2";
+
+        ts::EditResult result = tree.edit({edit}, chunked_reader(new_source));
+
+        CHECK(result.applied_edits.size() == 1);
+        CHECK(result.applied_edits[0].old_source.empty());
+        ts::Node new_ident = tree.root_node().named_child(0).value().named_child(0).value();
+        CHECK(new_ident.text() == "x"s);
+        CHECK(tree.root_node().text() == new_source);
+    }
+}
+
+TEST_CASE("ts::LineIndex", "[tree-sitter]") {
+    const ts::LineIndex index("ab\n\ncd\n");
+
+    CHECK(index.line_count() == 4);
+    CHECK(index.line_starts() == std::vector<std::uint32_t>{0, 3, 4, 7});
+
+    CHECK(index.point(0) == ts::Point{.row = 0, .column = 0});
+    CHECK(index.point(2) == ts::Point{.row = 0, .column = 2});
+    CHECK(index.point(3) == ts::Point{.row = 1, .column = 0});
+    CHECK(index.point(5) == ts::Point{.row = 2, .column = 1});
+    CHECK(index.location(7) == ts::Location{.point = {.row = 3, .column = 0}, .byte = 7});
+
+    SECTION("counts UTF-16 code units") {
+        // U+0A0A contains the byte of '\n' but is no newline
+        const std::u16string source = u"a\n\u0a0ab";
+        const ts::LineIndex utf16_index(
+            std::string_view(
+                reinterpret_cast<const char*>(source.data()), source.size() * sizeof(char16_t)),
+            ts::Encoding::UTF16);
+
+        CHECK(utf16_index.line_starts() == std::vector<std::uint32_t>{0, 4});
+        CHECK(utf16_index.point(6) == ts::Point{.row = 1, .column = 2});
+    }
+
+    SECTION("can be updated with edits") {
+        // "ab\n\ncd\n" -> "a\nx\n\ncd\nyz"
+        const std::vector<ts::AppliedEdit> edits{
+            ts::AppliedEdit{
+                .before = {.start = index.location(1), .end = index.location(3)},
+                .after = {},
+                .old_source = "b\n",
+                .replacement = "\nx\n",
+            },
+            ts::AppliedEdit{
+                .before = {.start = index.location(7), .end = index.location(7)},
+                .after = {},
+                .old_source = "",
+                .replacement = "yz",
+            },
+        };
+
+        CHECK(index.edited(edits).line_starts() == ts::LineIndex("a\nx\n\ncd\nyz").line_starts());
+    }
+}
+
+TEST_CASE("trees can be parsed from UTF-16", "[tree-sitter]") {
+    ts::Parser parser(LUA_LANGUAGE);
+
+    std::u16string source = u"local s = \"\u00e4\u00f6\u00fc\"";
+    ts::Tree tree = parser.parse_string_utf16(source);
+
+    CHECK(tree.source_buffer().encoding() == ts::Encoding::UTF16);
+    CHECK(!tree.root_node().has_error());
+    CHECK(tree.root_node().text_utf16() == source);
+
+    ts::Node string = tree.root_node().named_child(0).value().named_child(1).value();
+    // byte offsets are counted in bytes of the UTF-16 source code
+    CHECK(string.start_byte() == 10 * sizeof(char16_t));
+    CHECK(string.end_byte() == source.size() * sizeof(char16_t));
+    CHECK(string.text_utf16() == u"\"\u00e4\u00f6\u00fc\""s);
+
+    SECTION("from a borrowed string") {
+        ts::Tree borrowed = parser.parse_source(ts::Source::borrow_utf16(source));
+        CHECK(borrowed.source_buffer().utf16_view().data() == source.data());
+        CHECK(borrowed.root_node().text_utf16() == source);
+        CHECK(borrowed.root_node().text_utf16_view().data() == source.data());
+    }
+
+    SECTION("UTF-8 text is not available") {
+        REQUIRE_THROWS_AS(string.text(), ts::EncodingException);
+        REQUIRE_THROWS_AS(
+            parser.parse_string("1").root_node().text_utf16(), ts::EncodingException);
+    }
+
+    SECTION("can be edited") {
+        const ts::EditResult result = tree.edit({ts::Edit::utf16(string.range(), u"1\nx = 2")});
+
+        CHECK(tree.root_node().text_utf16() == u"local s = 1\nx = 2");
+        CHECK(!tree.root_node().has_error());
+        CHECK(result.applied_edits[0].after.end == ts::Location{
+                                                       .point = {.row = 1, .column = 10},
+                                                       .byte = 34,
+                                                   });
+    }
+
+    SECTION("can be edited with byte offsets") {
+        tree.edit({ts::Edit::from_bytes(20, 30, u"\"a\"\nx = 2")});
+
+        CHECK(tree.root_node().text_utf16() == u"local s = \"a\"\nx = 2");
+        CHECK(tree.root_node().end_point() == ts::Point{.row = 1, .column = 10});
+        CHECK(tree.line_index().line_starts() == std::vector<std::uint32_t>{0, 28});
+    }
+
+    SECTION("source code can be replaced") {
+        const ts::EditResult result = tree.update_source(u"local t = \"\u00e4\u00f6\u00fc\"");
+
+        REQUIRE(result.applied_edits.size() == 1);
+        CHECK(result.applied_edits[0].before.start.byte == 6 * sizeof(char16_t));
+        CHECK(tree.root_node().text_utf16() == u"local t = \"\u00e4\u00f6\u00fc\"");
+        REQUIRE_THROWS_AS(tree.update_source("local t = 1"), ts::EncodingException);
+        REQUIRE_THROWS_AS(
+            parser.parse_string("1").update_source(u"2"), ts::EncodingException);
+    }
+
+    SECTION("edits can be collected") {
+        ts::PendingEdits pending(std::move(tree));
+        pending.edit({ts::Edit::from_bytes(20, 30, u"1")});
+
+        CHECK(pending.source().size() == 11 * sizeof(char16_t));
+        CHECK(pending.root_node().end_byte() == 11 * sizeof(char16_t));
+        CHECK(!pending.root_node().has_error());
+        CHECK(pending.root_node().text_utf16() == u"local s = 1");
+        REQUIRE_THROWS_AS(pending.root_node().text(), ts::EncodingException);
+    }
+
+    SECTION("from a piece table") {
+        ts::Tree pieces_tree = parser.parse_piece_table(ts::PieceTable(ts::Source::utf16(source)));
+        const ts::Node root = pieces_tree.root_node();
+
+        CHECK(root.text_utf16() == source);
+        CHECK(root.text_utf16_view() == source);
+        REQUIRE_THROWS_AS(root.text(), ts::EncodingException);
+        REQUIRE_THROWS_AS(root.text_equals("local"), ts::EncodingException);
+        REQUIRE_THROWS_AS(root.text_starts_with("local"), ts::EncodingException);
+        REQUIRE_THROWS_AS(
+            pieces_tree.for_each_chunk(0, 2, [](std::string_view) {}), ts::EncodingException);
+
+        pieces_tree.edit({ts::Edit::from_bytes(0, 10, u"L")});
+        CHECK(pieces_tree.root_node().text_utf16() == u"L s = \"\u00e4\u00f6\u00fc\"");
+        REQUIRE_THROWS_AS(pieces_tree.root_node().text_utf16_view(), ts::TextViewException);
+    }
+}
+
+TEST_CASE("ts::PieceTable", "[tree-sitter]") {
+    const ts::PieceTable table{ts::Source("local a = 1")};
+
+    CHECK(table.size() == 11);
+    CHECK(table.pieces().size() == 1);
+    CHECK(table.chunk(6) == "a = 1");
+    CHECK(table.chunk(11).empty());
+
+    const std::vector<ts::AppliedEdit> edits{
+        ts::AppliedEdit{
+            .before = {.start = {.point = {}, .byte = 6}, .end = {.point = {}, .byte = 7}},
+            .after = {},
+            .old_source = "a",
+            .replacement = "abc",
+        },
+        ts::AppliedEdit{
+            .before = {.start = {.point = {}, .byte = 11}, .end = {.point = {}, .byte = 11}},
+            .after = {},
+            .old_source = "",
+            .replacement = "23",
+        },
+    };
+    const ts::PieceTable edited = table.edited(edits);
+
+    CHECK(edited.text(0, edited.size()) == "local abc = 123"s);
+    CHECK(edited.pieces().size() == 4);
+    CHECK(edited.chunk(7) == "bc");
+    // the unchanged text is not copied
+    CHECK(edited.pieces()[0].data() == table.pieces()[0].data());
+
+    // the original is not changed
+    CHECK(table.text(0, table.size()) == "local a = 1"s);
+}
+
+TEST_CASE("trees can be parsed from a piece table", "[tree-sitter]") {
+    ts::Parser parser(LUA_LANGUAGE);
+
+    ts::Tree tree = parser.parse_piece_table(ts::PieceTable(ts::Source("local a = 1 + 2")));
+
+    REQUIRE(tree.piece_table() != nullptr);
+    CHECK(tree.has_reader());
+    CHECK(!tree.root_node().has_error());
+
+    ts::Node bin_op = tree.root_node().named_child(0).value().named_child(1).value();
+    ts::Node two_node = bin_op.child(2).value();
+    CHECK(two_node.text() == "2"s);
+
+    SECTION("can be edited") {
+        ts::EditResult result =
+            tree.edit({ts::Edit{.range = two_node.range(), .replacement = "20 * 3"}});
+
+        CHECK(result.applied_edits[0].old_source == "2"s);
+        CHECK(tree.piece_table()->pieces().size() == 2);
+        CHECK(tree.root_node().text() == "local a = 1 + 20 * 3"s);
+        CHECK(!tree.root_node().has_error());
+
+        std::vector<std::string_view> chunks;
+        tree.root_node().for_each_chunk(
+            [&chunks](std::string_view chunk) { chunks.push_back(chunk); });
+        CHECK(chunks == std::vector<std::string_view>{"local a = 1 + ", "20 * 3"});
+    }
+}
+
+TEST_CASE("ts::PendingEdits", "[tree-sitter]") {
+    ts::Parser parser(LUA_LANGUAGE);
+
+    ts::PendingEdits pending(parser.parse_string("local a = 1"));
+    CHECK(!pending.has_pending());
+
+    // type "23" and then " + 4" at the end (one edit per keystroke)
+    std::string typed = "23 + 4";
+    std::uint32_t end = 11;
+    for (char c : typed) {
+        pending.edit({ts::Edit::from_bytes(end, end, std::string(1, c))});
+        ++end;
+    }
+
+    CHECK(pending.has_pending());
+    CHECK(pending.source().text(0, pending.source().size()) == "local a = 123 + 4"s);
+
+    // reading the tree reparses it once
+    ts::Node root = pending.root_node();
+    CHECK(!pending.has_pending());
+    CHECK(root.text() == "local a = 123 + 4"s);
+    CHECK(!root.has_error());
+
+    const ts::EditResult& result = pending.last_result();
+    CHECK(result.applied_edits.size() == typed.size());
+    CHECK(result.applied_edits.back().after.end == ts::Location{
+        .point = {.row = 0, .column = 17},
+        .byte = 17,
+    });
+    CHECK(!result.changed_ranges.empty());
+
+    SECTION("flushing without pending edits does nothing") {
+        CHECK(pending.flush().applied_edits.empty());
+        CHECK(pending.last_result() == result);
+    }
+}
+
+TEST_CASE("ts::AnchorSet", "[tree-sitter]") {
+    ts::Parser parser(LUA_LANGUAGE);
+    ts::Tree tree = parser.parse_string("local a = 1\nlocal b = 2\nlocal c = 3");
+    // range in the current source code of the tree
+    const auto range = [&tree](std::uint32_t start, std::uint32_t end) {
+        const ts::LineIndex& index = tree.line_index();
+        return ts::Range{.start = index.location(start), .end = index.location(end)};
+    };
+
+    const ts::AnchorSet::Id a = tree.add_anchor(range(6, 7));
+    const ts::AnchorSet::Id b = tree.add_anchor(range(18, 23));
+    const ts::AnchorSet::Id c = tree.add_anchor(range(30, 35));
+    CHECK(tree.anchors().size() == 3);
+
+    SECTION("anchors are moved along with edits") {
+        // "local a = 1\nlocal bb = 2\n\nlocal c = 3"
+        tree.edit({ts::Edit::from_bytes(18, 19, "bb"), ts::Edit::from_bytes(24, 24, "\n")});
+
+        CHECK(tree.anchors().range(a) == range(6, 7));
+        CHECK(tree.anchors().range(b) == range(18, 24));
+        CHECK(tree.anchors().range(c) == range(32, 37));
+        CHECK(tree.anchors().range(c)->start.point == ts::Point{.row = 3, .column = 6});
+    }
+
+    SECTION("anchors inside of a replaced range are moved to the replacement") {
+        // "local a = 1\nlocal c = 3"
+        tree.edit({ts::Edit::from_bytes(12, 24, "")});
+
+        CHECK(tree.anchors().range(b) == range(12, 12));
+        CHECK(tree.anchors().range(c) == range(18, 23));
+    }
+
+    SECTION("insertions at the start of an anchor are excluded and at its end included") {
+        const ts::AnchorSet::Id before_b = tree.add_anchor(range(12, 18));
+        // "local a = 1\nlocal xyzb = 2\nlocal c = 3"
+        tree.edit({ts::Edit::from_bytes(18, 18, "xyz")});
+
+        CHECK(tree.anchors().range(before_b) == range(12, 21));
+        CHECK(tree.anchors().range(b) == range(21, 26));
+        CHECK(tree.anchors().range(c) == range(33, 38));
+    }
+
+    SECTION("insertions at both ends of an anchor in one batch") {
+        const ts::AnchorSet::Id before_b = tree.add_anchor(range(12, 18));
+        // "Local a = 1\nlocal xyzb = 2!\nlocal c = 3"
+        tree.edit({
+            ts::Edit::from_bytes(0, 1, "L"),
+            ts::Edit::from_bytes(23, 23, "!"),
+            ts::Edit::from_bytes(18, 18, "xyz"),
+        });
+
+        CHECK(tree.anchors().range(a) == range(6, 7));
+        CHECK(tree.anchors().range(before_b) == range(12, 21));
+        CHECK(tree.anchors().range(b) == range(21, 27));
+        CHECK(tree.anchors().range(c) == range(34, 39));
+    }
+
+    SECTION("anchors are moved by pending edits") {
+        ts::PendingEdits pending(std::move(tree));
+        // "local a = 1\nlocal xyzb = 2\nlocal c = 3"
+        pending.edit({ts::Edit::from_bytes(18, 18, "xyz")});
+        // "local a = 1\nlocal xyzb = 2\n\nlocal c = 3"
+        pending.edit({ts::Edit::from_bytes(27, 27, "\n")});
+
+        REQUIRE(pending.has_pending());
+        const ts::Range b_range = pending.anchors().range(b).value();
+        CHECK(b_range.start.byte == 21);
+        CHECK(b_range.end.byte == 26);
+        const ts::Range c_range = pending.anchors().range(c).value();
+        CHECK(c_range.start == ts::Location{.point = {.row = 3, .column = 6}, .byte = 34});
+        CHECK(c_range.end.byte == 39);
+
+        // reparsing does not move them again
+        pending.flush();
+        CHECK(pending.tree().anchors().range(b) == b_range);
+        CHECK(pending.tree().anchors().range(c) == c_range);
+        CHECK(pending.anchors().range(a)->start.byte == 6);
+    }
+
+    SECTION("failed edits keep the anchors") {
+        const ts::Range b_range = range(18, 23);
+        REQUIRE_THROWS_AS(
+            tree.edit({ts::Edit::from_bytes(16, 20, "x"), ts::Edit::from_bytes(18, 22, "y")}),
+            ts::OverlappingEditException);
+
+        CHECK(tree.anchors().size() == 3);
+        CHECK(tree.anchors().range(b) == b_range);
+    }
+
+    SECTION("removed anchors are not moved") {
+        tree.remove_anchor(b);
+        tree.edit({ts::Edit::from_bytes(0, 0, "\n")});
+
+        CHECK(tree.anchors().size() == 2);
+        CHECK(!tree.anchors().range(b));
+        CHECK(tree.anchors().range(a) == range(7, 8));
+        CHECK(tree.anchors().range(a)->start.point == ts::Point{.row = 1, .column = 6});
+    }
+
+    SECTION("copies of the tree keep their anchors") {
+        const ts::Tree copy = tree;
+        const ts::Range a_range = range(6, 7);
+        tree.edit({ts::Edit::from_bytes(0, 0, "\n")});
+
+        CHECK(copy.anchors().range(a) == a_range);
+        CHECK(tree.anchors().range(a) == range(7, 8));
+    }
+}
+
+TEST_CASE("trees can be updated with a new source", "[tree-sitter]") {
+    ts::Parser parser(LUA_LANGUAGE);
+
+    SECTION("diff_edits only replaces the changed characters") {
+        std::vector<ts::Edit> edits = ts::diff_edits(
+            "local b = 2\nlocal c = 3\n", "local b = 20\nlocal c = 3\nlocal d = 4\n");
+        REQUIRE(edits.size() == 2);
+        CHECK(edits[0].range.start.byte == 11);
+        CHECK(edits[0].range.end.byte == 11);
+        CHECK(edits[0].replacement == "0");
+        CHECK(edits[1].range.start.byte == 24);
+        CHECK(edits[1].range.end.byte == 24);
+        CHECK(edits[1].replacement == "local d = 4\n");
+    }
+
+    SECTION("diff_edits of the same source is empty") {
+        CHECK(ts::diff_edits("local a = 1", "local a = 1").empty());
+    }
+
+    SECTION("updating the source reparses the tree") {
+        ts::Tree tree = parser.parse_string("local a = 1\nlocal b = 2");
+        ts::EditResult result = tree.update_source("local a = 1\nlocal b = 23\n");
+
+        CHECK(tree.source() == "local a = 1\nlocal b = 23\n"s);
+        CHECK(tree.root_node().text() == "local a = 1\nlocal b = 23\n"s);
+        CHECK(!tree.root_node().has_error());
+        REQUIRE(result.applied_edits.size() == 1);
+        CHECK(result.applied_edits[0].before.start.byte == 23);
+        CHECK(result.applied_edits[0].replacement == "3\n");
+        CHECK(result.applied_edits[0].after.end == ts::Location{
+            .point = {.row = 2, .column = 0},
+            .byte = 25,
+        });
+    }
+
+    SECTION("updating the source uses the edit options") {
+        ts::Tree tree = parser.parse_string("local a = 1");
+        ts::ReparseStatistics statistics;
+        ts::EditResult result = tree.update_source(
+            "print(2 + 3)", ts::EditOptions{
+                                .copy_old_source = false,
+                                .reparse_policy = ts::ReparsePolicy{.min_source_size = 0},
+                                .reparse_statistics = &statistics,
+                            });
+
+        CHECK(tree.root_node().text() == "print(2 + 3)"s);
+        CHECK(statistics.full_reparses == 1);
+        REQUIRE(!result.applied_edits.empty());
+        CHECK(result.applied_edits[0].old_source.empty());
+    }
+
+    SECTION("updating with the same source does nothing") {
+        ts::Tree tree = parser.parse_string("local a = 1");
+        CHECK(tree.update_source("local a = 1").applied_edits.empty());
+    }
 }
 
 TEST_CASE("trees can be edited", "[tree-sitter]") {
@@ -535,7 +1060,7 @@ return a + b)#";
         CHECK(new_two_node.text() == "7"s);
     }
 
-    SECTION("trying to apply a multiline edit") {
+    SECTION("applying a multiline edit") {
         std::string source = "1 + 2";
         ts::Tree tree = parser.parse_string(source);
 
@@ -551,7 +1076,163 @@ return a + b)#";
             .replacement = "3 +\n 4"s,
         };
 
-        REQUIRE_THROWS_AS(tree.edit({edit}), ts::MultilineEditException);
+        ts::EditResult result = tree.edit({edit});
+
+        CHECK(tree.source() == "3 +\n 4 + 2"s);
+        CHECK(!tree.root_node().has_error());
+        CHECK(
+            result.applied_edits[0].after ==
+            ts::Range{
+                .start = {.point = {.row = 0, .column = 0}, .byte = 0},
+                .end = {.point = {.row = 1, .column = 2}, .byte = 6}});
+
+        ts::Node new_two_node =
+            tree.root_node().named_child(0).value().named_child(0).value().child(2).value();
+        CHECK(new_two_node.text() == "2"s);
+        CHECK(new_two_node.start_point() == ts::Point{.row = 1, .column = 5});
+    }
+
+    SECTION("inserting and deleting text") {
+        std::string source = "1 + 2";
+        ts::Tree tree = parser.parse_string(source);
+
+        auto location = [](std::uint32_t column) {
+            return ts::Location{.point = {.row = 0, .column = column}, .byte = column};
+        };
+        auto range = [&](std::uint32_t start, std::uint32_t end) {
+            return ts::Range{.start = location(start), .end = location(end)};
+        };
+
+        ts::EditResult result = tree.edit({
+            ts::Edit{.range = range(5, 5), .replacement = "3"s},
+            ts::Edit{.range = range(1, 1), .replacement = "0"s},
+            ts::Edit{.range = range(4, 5), .replacement = ""s},
+            ts::Edit{.range = range(1, 1), .replacement = "0"s},
+        });
+
+        CAPTURE(result);
+
+        CHECK(tree.source() == "100 + 3"s);
+        CHECK(!tree.root_node().has_error());
+
+        REQUIRE(result.applied_edits.size() == 4);
+        CHECK(result.applied_edits[0].after == range(1, 2));
+        CHECK(result.applied_edits[1].after == range(2, 3));
+        CHECK(result.applied_edits[2].after == range(6, 6));
+        CHECK(result.applied_edits[2].old_source == "2"s);
+        CHECK(result.applied_edits[3].after == range(6, 7));
+
+        ts::Node bin_op = tree.root_node().named_child(0).value().named_child(0).value();
+        CHECK(bin_op.child(0).value().text() == "100"s);
+        CHECK(bin_op.child(2).value().text() == "3"s);
+    }
+
+    SECTION("edits can be created from byte offsets") {
+        std::string source = R"#(local a = 1
+local b = 2)#";
+        ts::Tree tree = parser.parse_string(source);
+
+        ts::Node two_node = tree.root_node().named_child(1).value().named_child(1).value();
+        ts::Edit edit = ts::Edit::from_bytes(two_node.start_byte(), two_node.end_byte(), "42");
+        CHECK(edit.bytes_only);
+
+        ts::EditResult result = tree.edit({edit});
+
+        CHECK(tree.source() == "local a = 1\nlocal b = 42"s);
+        CHECK(result.applied_edits[0].before == two_node.range());
+        CHECK(
+            result.applied_edits[0].after ==
+            ts::Range{
+                .start = {.point = {.row = 1, .column = 10}, .byte = 22},
+                .end = {.point = {.row = 1, .column = 12}, .byte = 24}});
+    }
+
+    SECTION("the replaced text can be read from a copy of the tree") {
+        ts::Tree tree = parser.parse_string("local a = 1 + 2");
+        const ts::Tree old_tree = tree;
+
+        ts::EditResult result = tree.edit(
+            {ts::Edit::from_bytes(10, 11, "3"), ts::Edit::from_bytes(14, 15, "40")},
+            ts::EditOptions{.copy_old_source = false});
+
+        CHECK(tree.source() == "local a = 3 + 40"s);
+        REQUIRE(result.applied_edits.size() == 2);
+        for (const ts::AppliedEdit& applied_edit : result.applied_edits) {
+            CHECK(applied_edit.old_source.empty());
+        }
+
+        const ts::AppliedEdit& second = result.applied_edits[1];
+        CHECK(old_tree.text(second.before.start.byte, second.before.end.byte) == "2"s);
+        CHECK(tree.text(second.after.start.byte, second.after.end.byte) == "40"s);
+        CHECK(second.replacement == "40"s);
+    }
+
+    SECTION("trying to insert text inside of another edit") {
+        std::string source = "11 + 2";
+        ts::Tree tree = parser.parse_string(source);
+
+        ts::Node one_node =
+            tree.root_node().named_child(0).value().named_child(0).value().child(0).value();
+        ts::Location middle{
+            .point = {.row = 0, .column = 1},
+            .byte = 1,
+        };
+
+        ts::Edit edit{.range = one_node.range(), .replacement = "3"s};
+        ts::Edit insertion{.range = {.start = middle, .end = middle}, .replacement = "4"s};
+
+        REQUIRE_THROWS_AS(tree.edit({edit, insertion}), ts::OverlappingEditException);
+    }
+
+    SECTION("edits after a multiline edit are adjusted") {
+        std::string source = R"#(local a = 1
+local b = 2
+local c = 3)#";
+        ts::Tree tree = parser.parse_string(source);
+        // create the line index before the edit so it is updated by it
+        CHECK(tree.line_index().line_count() == 3);
+
+        ts::Node one_node = tree.root_node().named_child(0).value().named_child(1).value();
+        ts::Node two_node = tree.root_node().named_child(1).value().named_child(1).value();
+        ts::Node three_node = tree.root_node().named_child(2).value().named_child(1).value();
+        CHECK(three_node.text() == "3"s);
+
+        // removes the second line
+        ts::Edit edit_one{
+            .range = {.start = one_node.start(), .end = two_node.end()},
+            .replacement = "12"s,
+        };
+        ts::Edit edit_three{
+            .range = three_node.range(),
+            .replacement = "4"s,
+        };
+
+        ts::EditResult result = tree.edit({edit_three, edit_one});
+
+        CAPTURE(result);
+
+        std::string expected = R"#(local a = 12
+local c = 4)#";
+        CHECK(tree.source() == expected);
+        CHECK(!tree.root_node().has_error());
+
+        CHECK(result.applied_edits.size() == 2);
+        CHECK(
+            result.applied_edits[0].after ==
+            ts::Range{
+                .start = {.point = {.row = 0, .column = 10}, .byte = 10},
+                .end = {.point = {.row = 0, .column = 12}, .byte = 12}});
+        CHECK(
+            result.applied_edits[1].after ==
+            ts::Range{
+                .start = {.point = {.row = 1, .column = 10}, .byte = 23},
+                .end = {.point = {.row = 1, .column = 11}, .byte = 24}});
+
+        ts::Node new_three_node = tree.root_node().named_child(1).value().named_child(1).value();
+        CHECK(new_three_node.text() == "4"s);
+        CHECK(new_three_node.range() == result.applied_edits[1].after);
+
+        CHECK(tree.line_index().line_starts() == ts::LineIndex(tree.source()).line_starts());
     }
 
     SECTION("trying to apply overlapping edits") {
@@ -593,6 +1274,360 @@ return a + b)#";
 
         REQUIRE_THROWS_AS(tree.edit({edit, edit2}), ts::OverlappingEditException);
     }
+
+    SECTION("trying to apply an edit that contains other edits") {
+        std::string source = "11 + 2";
+        ts::Tree tree = parser.parse_string(source);
+
+        ts::Node bin_op = tree.root_node().named_child(0).value().named_child(0).value();
+        ts::Node one_node = bin_op.child(0).value();
+        ts::Node two_node = bin_op.child(2).value();
+        CHECK(two_node.text() == "2"s);
+
+        ts::Edit outer{.range = bin_op.range(), .replacement = "5"s};
+        ts::Edit inner1{.range = one_node.range(), .replacement = "3"s};
+        ts::Edit inner2{.range = two_node.range(), .replacement = "4"s};
+
+        REQUIRE_THROWS_AS(
+            tree.edit({inner2, inner1, outer}), ts::OverlappingEditException);
+    }
+}
+
+TEST_CASE("ts::ReparsePolicy", "[tree-sitter]") {
+    ts::Parser parser(LUA_LANGUAGE);
+
+    ts::ReparseStatistics statistics;
+    ts::EditOptions options{
+        .reparse_policy = ts::ReparsePolicy{.min_source_size = 0},
+        .reparse_statistics = &statistics,
+    };
+
+    SECTION("decides by the number of edits and touched bytes") {
+        ts::ReparsePolicy policy{
+            .min_source_size = 10, .max_incremental_edits = 2, .max_touched_fraction = 0.5};
+        CHECK(!policy.full_reparse(2, 50, 100));
+        CHECK(policy.full_reparse(3, 3, 100));
+        CHECK(policy.full_reparse(1, 51, 100));
+        // small source code is always reparsed incrementally
+        CHECK(!policy.full_reparse(3, 9, 9));
+    }
+
+    SECTION("small edits are reparsed incrementally") {
+        ts::Tree tree = parser.parse_string("local a = 1 + 2 * 3");
+        tree.edit({ts::Edit::from_bytes(10, 11, "4")}, options);
+
+        CHECK(tree.root_node().text() == "local a = 4 + 2 * 3"s);
+        CHECK(statistics.incremental_reparses == 1);
+        CHECK(statistics.full_reparses == 0);
+    }
+
+    SECTION("rewriting most of the source code reparses it from scratch") {
+        ts::Tree tree = parser.parse_string("local a = 1");
+        ts::EditResult result = tree.edit({ts::Edit::from_bytes(0, 11, "print(2 + 3)")}, options);
+
+        CHECK(tree.root_node().text() == "print(2 + 3)"s);
+        CHECK(!tree.root_node().has_error());
+        CHECK(statistics.incremental_reparses == 0);
+        CHECK(statistics.full_reparses == 1);
+
+        // everything could have changed
+        CHECK(result.changed_ranges == std::vector<ts::Range>{{
+            .start = {.point = {.row = 0, .column = 0}, .byte = 0},
+            .end = {.point = {.row = 0, .column = 12}, .byte = 12},
+        }});
+        REQUIRE(result.applied_edits.size() == 1);
+        CHECK(result.applied_edits[0].old_source == "local a = 1");
+        CHECK(result.applied_edits[0].after.end.byte == 12);
+    }
+
+    SECTION("the statistics are aggregated over multiple trees") {
+        options.reparse_policy->max_incremental_edits = 1;
+        ts::Tree tree = parser.parse_piece_table(ts::PieceTable(ts::Source("local a = 1 + 2")));
+        tree.edit({ts::Edit::from_bytes(10, 11, "3"), ts::Edit::from_bytes(14, 15, "4")}, options);
+
+        CHECK(tree.root_node().text() == "local a = 3 + 4"s);
+        CHECK(!tree.root_node().has_error());
+
+        ts::PendingEdits pending(parser.parse_string("local b = 1"), options);
+        pending.edit({ts::Edit::from_bytes(10, 11, "2")});
+        pending.flush();
+
+        CHECK(pending.root_node().text() == "local b = 2"s);
+        CHECK(statistics.full_reparses == 1);
+        CHECK(statistics.incremental_reparses == 1);
+    }
+
+    SECTION("edits are reparsed incrementally by default") {
+        ts::Tree tree = parser.parse_string("1 + 2");
+        ts::EditResult result = tree.edit({ts::Edit::from_bytes(4, 5, "33")});
+
+        CHECK(tree.root_node().text() == "1 + 33"s);
+        // only the changed number, not the whole tree
+        REQUIRE(!result.changed_ranges.empty());
+        for (const ts::Range& range : result.changed_ranges) {
+            CHECK(range.start.byte >= 4);
+        }
+    }
+}
+
+TEST_CASE("parsing can be halted and resumed", "[tree-sitter]") {
+    ts::Parser parser(LUA_LANGUAGE);
+
+    std::string source;
+    for (int i = 0; i < 10000; ++i) {
+        source += "local a" + std::to_string(i) + " = " + std::to_string(i) + "\n";
+    }
+
+    SECTION("timeout") {
+        parser.set_timeout_micros(1);
+        CHECK(parser.timeout_micros() == 1);
+
+        REQUIRE_THROWS_AS(parser.parse_string(source), ts::ParseFailureException);
+
+        ts::ParseTask task(parser, source);
+        std::optional<ts::Tree> tree;
+        int slices = 0;
+        while (!(tree = task.resume())) {
+            CHECK(task.is_running());
+            ++slices;
+        }
+
+        CHECK(slices > 0);
+        CHECK(!task.is_running());
+        CHECK(tree->source() == source);
+        CHECK(!tree->root_node().has_error());
+    }
+
+    SECTION("cancellation flag") {
+        std::atomic<std::size_t> cancelled{1};
+        parser.set_cancellation_flag(&cancelled);
+        CHECK(parser.cancellation_flag() == &cancelled);
+
+        REQUIRE_THROWS_AS(parser.parse_string(source), ts::ParseFailureException);
+
+        ts::ParseTask task(parser, source);
+        CHECK(!task.resume());
+
+        cancelled = 0;
+        std::optional<ts::Tree> tree = task.resume();
+        REQUIRE(tree);
+        CHECK(!tree->root_node().has_error());
+
+        parser.set_cancellation_flag(nullptr);
+    }
+
+    SECTION("abandoned tasks reset the parser") {
+        parser.set_timeout_micros(1);
+        {
+            ts::ParseTask task(parser, source);
+            CHECK(!task.resume());
+        }
+        parser.set_timeout_micros(0);
+
+        ts::Tree tree = parser.parse_string("1 + 2");
+        CHECK(tree.root_node().text() == "1 + 2"s);
+        CHECK(!tree.root_node().has_error());
+    }
+}
+
+TEST_CASE("parser can parse included ranges only", "[tree-sitter]") {
+    ts::Parser parser(LUA_LANGUAGE);
+
+    std::string source = "local a = 1\n#!garbage!#\nlocal c = 3";
+    ts::Tree full_tree = parser.parse_string(source);
+    CHECK(full_tree.root_node().has_error());
+
+    ts::Node first_statement = full_tree.root_node().named_child(0).value();
+    ts::Range first_line = first_statement.range();
+    ts::Range third_line{
+        .start = {.point = {.row = 2, .column = 0}, .byte = 24},
+        .end = {.point = {.row = 2, .column = 11}, .byte = 35}};
+
+    SECTION("on the parser") {
+        parser.set_included_ranges({first_line, third_line});
+        CHECK(parser.included_ranges() == std::vector<ts::Range>{first_line, third_line});
+
+        ts::Tree tree = parser.parse_string(source);
+        CHECK(!tree.root_node().has_error());
+        CHECK(tree.root_node().named_child_count() == 2);
+
+        ts::Node number = tree.root_node().named_child(1).value().named_child(1).value();
+        CHECK(number.text() == "3"s);
+
+        parser.set_included_ranges({});
+    }
+
+    SECTION("ranges have to be sorted") {
+        REQUIRE_THROWS_AS(
+            parser.set_included_ranges({third_line, first_line}), ts::IncludedRangesException);
+    }
+
+    SECTION("in a layered tree") {
+        ts::LayeredTree layered{std::move(full_tree)};
+        std::size_t index = layered.add_layer(parser, {first_line, third_line});
+        CHECK(parser.included_ranges().size() == 1);
+
+        const ts::Tree& layer = layered.layer(index);
+        CHECK(!layer.root_node().has_error());
+        CHECK(layer.source().data() == layered.root().source().data());
+
+        // edit outside of the layer
+        ts::Range garbage{
+            .start = {.point = {.row = 1, .column = 2}, .byte = 14},
+            .end = {.point = {.row = 1, .column = 9}, .byte = 21}};
+        ts::LayeredEditResult result =
+            layered.edit({ts::Edit{.range = garbage, .replacement = "x"}});
+
+        CHECK(layered.root().source() == "local a = 1\n#!x!#\nlocal c = 3"s);
+        CHECK(result.layers.size() == 1);
+        CHECK(result.layers[0].empty());
+        CHECK(layered.layer_ranges(index)[1].start.byte == 18);
+        ts::Node number_3 =
+            layered.layer(index).root_node().named_child(1).value().named_child(1).value();
+        CHECK(number_3.start_byte() == 28);
+        CHECK(number_3.text() == "3"s);
+
+        // edit inside of the layer
+        ts::Edit edit{.range = number_3.range(), .replacement = "42"};
+        layered.edit({edit});
+
+        CHECK(layered.layer_ranges(index)[1].end.byte == 30);
+        ts::Node number_42 =
+            layered.layer(index).root_node().named_child(1).value().named_child(1).value();
+        CHECK(number_42.text() == "42"s);
+        CHECK(!layered.layer(index).root_node().has_error());
+    }
+
+    SECTION("layers are reparsed even if the parser is cancelled") {
+        ts::LayeredTree layered{std::move(full_tree)};
+        std::size_t index = layered.add_layer(parser, {first_line, third_line});
+        ts::Node number_3 =
+            layered.layer(index).root_node().named_child(1).value().named_child(1).value();
+
+        std::atomic<std::size_t> cancelled{1};
+        parser.set_cancellation_flag(&cancelled);
+        ts::LayeredEditResult result =
+            layered.edit({ts::Edit{.range = number_3.range(), .replacement = "42"}});
+        CHECK(parser.cancellation_flag() == &cancelled);
+        parser.set_cancellation_flag(nullptr);
+
+        CHECK(result.layers.size() == 1);
+        ts::Node number_42 =
+            layered.layer(index).root_node().named_child(1).value().named_child(1).value();
+        CHECK(number_42.text() == "42"s);
+        CHECK(layered.layer_ranges(index)[1].end.byte == 36);
+    }
+}
+
+TEST_CASE("ts::ParserPool", "[tree-sitter]") {
+    ts::ParserPool pool(LUA_LANGUAGE, 2);
+
+    CHECK(pool.max_size() == 2);
+    CHECK(pool.size() == 0);
+
+    SECTION("creates parsers lazily up to the maximum size") {
+        ts::PooledParser parser1 = pool.checkout();
+        CHECK(pool.size() == 1);
+        ts::PooledParser parser2 = pool.checkout();
+        CHECK(pool.size() == 2);
+        CHECK(&*parser1 != &*parser2);
+        CHECK(parser1->pool() == &pool);
+
+        CHECK(!pool.try_checkout());
+    }
+
+    SECTION("returned parsers are reused") {
+        ts::Parser* first = nullptr;
+        {
+            ts::PooledParser parser = pool.checkout();
+            first = &*parser;
+        }
+        CHECK(pool.idle_count() == 1);
+
+        ts::PooledParser parser = pool.checkout();
+        CHECK(&*parser == first);
+        CHECK(pool.size() == 1);
+    }
+
+    SECTION("trees re-acquire a parser for edits") {
+        ts::Tree tree = pool.parse_string("1 + 2");
+        CHECK(pool.idle_count() == 1);
+
+        ts::Node one_node =
+            tree.root_node().named_child(0).value().named_child(0).value().child(0).value();
+        tree.edit({ts::Edit{.range = one_node.range(), .replacement = "15"}});
+
+        CHECK(tree.source() == "15 + 2"s);
+        CHECK(tree.parser().pool() == &pool);
+        CHECK(pool.idle_count() == pool.size());
+    }
+
+    SECTION("can be used from multiple threads") {
+        std::vector<std::string> results(8);
+        std::vector<std::thread> threads;
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            threads.emplace_back([&pool, &results, i]() {
+                ts::Tree tree = pool.parse_string("local a = " + std::to_string(i));
+                results[i] = tree.root_node().named_child(0).value().named_child(1).value().text();
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        CHECK(pool.size() <= 2);
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            CHECK(results[i] == std::to_string(i));
+        }
+    }
+}
+
+TEST_CASE("ts::parse_many", "[tree-sitter]") {
+    ts::ParserPool pool(LUA_LANGUAGE, 4);
+
+    std::vector<ts::Source> sources;
+    for (int i = 0; i < 100; ++i) {
+        sources.emplace_back("local a = " + std::to_string(i));
+    }
+
+    SECTION("returns the trees in input order") {
+        std::vector<ts::ParseResult> results = ts::parse_many(pool, sources);
+
+        REQUIRE(results.size() == sources.size());
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            REQUIRE(results[i].tree);
+            CHECK(!results[i].error);
+            CHECK(results[i].tree->source() == sources[i].view());
+            ts::Node number =
+                results[i].tree->root_node().named_child(0).value().named_child(1).value();
+            CHECK(number.text() == std::to_string(i));
+        }
+        CHECK(pool.size() <= 4);
+    }
+
+    SECTION("can be cancelled") {
+        std::atomic<std::size_t> cancelled{1};
+        std::vector<ts::ParseResult> results =
+            ts::parse_many(pool, sources, {.threads = 2, .cancelled = &cancelled});
+
+        REQUIRE(results.size() == sources.size());
+        for (const auto& result : results) {
+            CHECK(result.cancelled());
+        }
+    }
+
+    SECTION("the cancellation flag is only installed while parsing") {
+        std::atomic<std::size_t> cancelled{0};
+        std::vector<ts::ParseResult> results =
+            ts::parse_many(pool, sources, {.threads = 2, .cancelled = &cancelled});
+
+        for (const auto& result : results) {
+            CHECK(result.tree);
+        }
+
+        ts::PooledParser parser = pool.checkout();
+        CHECK(parser->cancellation_flag() == nullptr);
+    }
 }
 
 TEST_CASE("Tree-Sitter detects errors", "[tree-sitter][parse]") {
@@ -686,6 +1721,20 @@ TEST_CASE("ts::Cursor", "[tree-sitter]") {
         CHECK(cursor.current_node().type() == "binary_operation"s);
     }
 
+    SECTION("can walk to the node at a byte offset") {
+        ts::Cursor cursor{tree};
+
+        // program -> expression -> binary_operation -> number
+        while (cursor.current_node().type() != "binary_operation"s) {
+            REQUIRE(cursor.goto_first_child_for_byte(4));
+        }
+        CHECK(cursor.goto_first_child_for_byte(4) == 2u);
+        CHECK(cursor.current_node().text() == "2"s);
+
+        CHECK(!cursor.goto_first_child_for_byte(4));
+        CHECK(cursor.current_node().text() == "2"s);
+    }
+
     SECTION("can be copied") {
         const ts::Cursor cursor{tree};
         ts::Cursor cursor2{tree};
@@ -725,6 +1774,76 @@ TEST_CASE("ts::Cursor", "[tree-sitter]") {
     }
 }
 
+TEST_CASE("tree visitors", "[tree-sitter]") {
+    ts::Parser parser(LUA_LANGUAGE);
+
+    std::string source = "1 + 2";
+    ts::Tree tree = parser.parse_string(source);
+
+    std::vector<std::string> types;
+    auto collect_types = [&](ts::Node node) { types.emplace_back(node.type()); };
+
+    SECTION("visit_preorder visits parents before their children") {
+        CHECK(ts::visit_preorder(tree.root_node(), collect_types));
+        CHECK(types == std::vector<std::string>{
+                           "program", "expression", "binary_operation", "number", "+", "number"});
+    }
+
+    SECTION("visit_postorder visits children before their parents") {
+        CHECK(ts::visit_postorder(tree.root_node(), collect_types));
+        CHECK(types == std::vector<std::string>{
+                           "number", "+", "number", "binary_operation", "expression", "program"});
+    }
+
+    SECTION("visit_tree visits all nodes in pre-order") {
+        ts::visit_tree(tree, collect_types);
+        CHECK(types.size() == 6);
+        CHECK(types.front() == "program");
+    }
+
+    SECTION("visitors can skip the children of a node") {
+        CHECK(ts::visit_preorder(tree.root_node(), [&](ts::Node node) {
+            collect_types(node);
+            return node.type() == "binary_operation"s ? ts::VisitAction::SkipChildren
+                                                      : ts::VisitAction::Continue;
+        }));
+        CHECK(types == std::vector<std::string>{"program", "expression", "binary_operation"});
+    }
+
+    SECTION("visitors can stop early") {
+        auto stop_at_plus = [&](ts::Node node) {
+            collect_types(node);
+            return node.type() == "+"s ? ts::VisitAction::Stop : ts::VisitAction::Continue;
+        };
+
+        ts::Cursor cursor{tree};
+        CHECK(!ts::visit_preorder(cursor, stop_at_plus));
+        CHECK(cursor.current_node().type() == "+"s);
+        CHECK(types.size() == 5);
+
+        types.clear();
+        cursor.reset(tree);
+        CHECK(!ts::visit_postorder(cursor, stop_at_plus));
+        CHECK(cursor.current_node().type() == "+"s);
+        CHECK(types.size() == 2);
+    }
+
+    SECTION("the cursor returns to the start node") {
+        ts::Cursor cursor{tree};
+        REQUIRE(cursor.goto_first_child());
+
+        CHECK(ts::visit_preorder(cursor, collect_types));
+        CHECK(cursor.current_node().type() == "expression"s);
+        CHECK(ts::visit_postorder(cursor, collect_types));
+        CHECK(cursor.current_node().type() == "expression"s);
+
+        types.clear();
+        ts::visit_children(cursor, collect_types);
+        CHECK(cursor.current_node().type() == "expression"s);
+        CHECK(types == std::vector<std::string>{"binary_operation", "number", "+", "number"});
+    }
+}
+
 TEST_CASE("ts::Node", "[tree-sitter]") {
     static_assert(std::is_nothrow_copy_constructible_v<ts::Node>);
     static_assert(std::is_nothrow_move_constructible_v<ts::Node>);
@@ -854,6 +1973,101 @@ TEST_CASE("ts::Node", "[tree-sitter]") {
         CHECK(children.size() >= named_children.size());
     }
 
+    SECTION("child ranges visit the children in order") {
+        ts::Node bin_op = root.named_child(0).value().named_child(0).value();
+
+        std::vector<ts::Node> children;
+        for (const ts::Node child : bin_op.child_range()) {
+            children.push_back(child);
+        }
+        CHECK(children == std::vector<ts::Node>{
+                              bin_op.child(0).value(),
+                              bin_op.child(1).value(),
+                              bin_op.child(2).value(),
+                          });
+        CHECK(children == bin_op.children());
+
+        std::vector<ts::Node> named_children;
+        ts::ChildRange named_range = bin_op.named_child_range();
+        std::copy(named_range.begin(), named_range.end(), std::back_inserter(named_children));
+        CHECK(named_children == std::vector<ts::Node>{
+                                    bin_op.named_child(0).value(),
+                                    bin_op.named_child(1).value(),
+                                });
+        CHECK(named_children == bin_op.named_children());
+
+        ts::Node number_1 = named_children[0];
+        CHECK(number_1.child_range().begin() == number_1.child_range().end());
+
+        ts::ChildRange range = bin_op.child_range();
+        auto it = range.begin();
+        CHECK(*it++ == children[0]);
+        CHECK(*it == children[1]);
+    }
+
+    SECTION("children can be looked up by field") {
+        const ts::FieldHandle object_field(LUA_LANGUAGE, "object");
+        CHECK(object_field.id() == LUA_LANGUAGE.field_id("object"));
+        CHECK(object_field.name() == "object"s);
+        CHECK(object_field.language().raw() == LUA_LANGUAGE.raw());
+        REQUIRE_THROWS_AS(ts::FieldHandle(LUA_LANGUAGE, "no_such_field"), ts::FieldException);
+
+        CHECK(!root.child_by_field(object_field));
+        CHECK(root.children_by_field(object_field).empty());
+
+        // the field lookups have to find the same children as the cursor
+        ts::Tree fields_tree = parser.parse_string("a:b(1)\nlocal x = a.y");
+        std::size_t field_children = 0;
+        std::vector<ts::Node> nodes{fields_tree.root_node()};
+        while (!nodes.empty()) {
+            const ts::Node node = nodes.back();
+            nodes.pop_back();
+
+            ts::ChildRange range = node.child_range();
+            for (auto it = range.begin(); it != range.end(); ++it) {
+                const ts::Node child = *it;
+                nodes.push_back(child);
+                if (it.field_id() == 0) {
+                    continue;
+                }
+                ++field_children;
+
+                const std::vector<ts::Node> same_field = node.children_by_field(it.field_id());
+                CHECK(std::find(same_field.begin(), same_field.end(), child) != same_field.end());
+                CHECK(node.child_by_field(it.field_id()) == same_field.front());
+            }
+        }
+        CHECK(field_children > 0);
+
+        // children without a field can't be looked up with the field id 0
+        const ts::Node fields_root = fields_tree.root_node();
+        REQUIRE(fields_root.child_count() > 0);
+        CHECK(!fields_root.child_by_field(0));
+        CHECK(fields_root.children_by_field(0).empty());
+        ts::ChildRange no_field_range = fields_root.field_child_range(0);
+        CHECK(no_field_range.begin() == no_field_range.end());
+    }
+
+    SECTION("descendants can be found by position") {
+        ts::Node bin_op = root.named_child(0).value().named_child(0).value();
+        ts::Node plus = bin_op.child(1).value();
+        ts::Node number_2 = bin_op.named_child(1).value();
+
+        CHECK(root.descendant_for_byte_range(4, 4) == number_2);
+        CHECK(root.descendant_for_byte_range(2, 3) == plus);
+        CHECK(root.descendant_for_byte_range(0, 5) == bin_op);
+        CHECK(root.named_descendant_for_byte_range(2, 3) == bin_op);
+        CHECK(number_2.descendant_for_byte_range(0, 1) == number_2);
+
+        CHECK(root.descendant_for_point_range({0, 4}, {0, 4}) == number_2);
+        CHECK(root.descendant_for_point_range({0, 2}, {0, 3}) == plus);
+        CHECK(root.named_descendant_for_point_range({0, 2}, {0, 3}) == bin_op);
+
+        CHECK(bin_op.first_child_for_byte(2) == plus);
+        CHECK(bin_op.first_named_child_for_byte(2) == number_2);
+        CHECK(!bin_op.first_child_for_byte(5));
+    }
+
     SECTION("nodes know their parents") {
         CHECK(!root.parent());
 
@@ -890,6 +2104,35 @@ TEST_CASE("ts::Node", "[tree-sitter]") {
         CHECK(plus_op.prev_named_sibling() == number_1);
         CHECK(!number_1.prev_sibling());
     }
+
+    SECTION("text can be compared without copying it") {
+        ts::Node bin_op = root.named_child(0).value().named_child(0).value();
+        ts::Node number_1 = bin_op.named_child(0).value();
+
+        CHECK(bin_op.text_view() == "1 + 2");
+        CHECK(bin_op.text_view().data() == tree.source().data());
+        CHECK(bin_op.text_equals("1 + 2"));
+        CHECK(!bin_op.text_equals("1 + 3"));
+        CHECK(!bin_op.text_equals("1 +"));
+        CHECK(bin_op.text_starts_with("1 +"));
+        CHECK(!bin_op.text_starts_with("1 + 2 + 3"));
+        CHECK(bin_op.text_hash() == ts::text_hash("1 + 2"));
+        CHECK(number_1.text_hash() != bin_op.text_hash());
+    }
+
+    SECTION("text of piece tables can be compared without joining the pieces") {
+        ts::Tree pieces_tree = parser.parse_piece_table(ts::PieceTable(ts::Source("1 + ")));
+        pieces_tree.edit({ts::Edit::from_bytes(4, 4, "2")});
+
+        ts::Node bin_op = pieces_tree.root_node().named_child(0).value().named_child(0).value();
+        ts::Node number_1 = bin_op.named_child(0).value();
+
+        CHECK(number_1.text_view() == "1");
+        CHECK_THROWS_AS(bin_op.text_view(), ts::TextViewException);
+        CHECK(bin_op.text_equals("1 + 2"));
+        CHECK(bin_op.text_starts_with("1 + 2"));
+        CHECK(bin_op.text_hash() == ts::text_hash("1 + 2"));
+    }
 }
 
 TEST_CASE("tree-sitter parses lua programs", "[tree-sitter][parser]") {